@@ -1,7 +1,43 @@
 .section .multiboot
     .long 0x1BADB002              # magic
-    .long 0x00000000              # flags
-    .long -(0x1BADB002 + 0x00000000)  # checksum
+    .long 0x00000003              # flags: page-aligned modules, memory info
+    .long -(0x1BADB002 + 0x00000003)  # checksum
+
+.section .bss
+.align 16
+.global stack_bottom
+.global stack_top
+stack_bottom:
+    .skip 16384                   # 16 KiB kernel stack
+stack_top:
+
+.align 8
+.global isr_entry_tsc
+isr_entry_tsc:
+    .skip 8                       # TSC when isr_common was entered
+
+.section .data
+.align 8
+gdt:
+    .quad 0x0000000000000000      # null
+    .quad 0x00CF9A000000FFFF      # 0x08: flat 4 GiB code
+    .quad 0x00CF92000000FFFF      # 0x10: flat 4 GiB data
+gdt_end:
+gdt_descriptor:
+    .word gdt_end - gdt - 1
+    .long gdt
+
+.global boot_tsc
+boot_tsc:
+    .quad 0
+.global fpu_present
+fpu_present:
+    .long 0
+.global sse_enabled
+sse_enabled:
+    .long 0
+fpu_probe_word:
+    .word 0x55AA
 
 .section .text
 .global _start
@@ -9,8 +45,166 @@
 .extern kernel_main
 _start:
     cli                 # Disable interrupts
+    movl $stack_top, %esp
+    subl $8, %esp       # Padding: the two arguments then leave esp 16-byte aligned at
+                        # the call, as the SSE code compiled under kernel_main requires
+    pushl %ebx          # Multiboot info pointer, kernel_main's second argument
+    pushl %eax          # Multiboot magic, its first
+    rdtsc               # Time zero of the boot timeline
+    movl %eax, boot_tsc
+    movl %edx, boot_tsc+4
+
+    lgdt gdt_descriptor # Our own flat segments, GRUB's GDT may go away
+    ljmp $0x08, $.reload_cs
+.reload_cs:
+    movw $0x10, %ax
+    movw %ax, %ds
+    movw %ax, %es
+    movw %ax, %fs
+    movw %ax, %gs
+    movw %ax, %ss
+
+    call fpu_setup
+
+    xorl %ebp, %ebp     # Ends the frame-pointer chain for backtraces
     call kernel_main		# Call your main function
 
 .hang:
     hlt
     jmp .hang           # Halt forever after running kernel_main
+
+# Enable the x87 (CR0.MP/NE, clear EM) and, when CPUID reports FXSR and SSE,
+# FXSAVE/SSE with unmasked SIMD exceptions (CR4.OSFXSR/OSXMMEXCPT).
+# Without an FPU, CR0.EM stays set so stray FPU opcodes fault instead.
+fpu_setup:
+    movl %cr0, %eax
+    andl $~0x0C, %eax             # clear EM, TS
+    orl $0x22, %eax               # set MP, NE
+    movl %eax, %cr0
+    fninit
+    fnstsw fpu_probe_word
+    cmpw $0, fpu_probe_word
+    jne .no_fpu
+    movl $1, fpu_present
+
+    pushfl                        # CPUID exists if EFLAGS.ID toggles
+    popl %eax
+    movl %eax, %ecx
+    xorl $0x200000, %eax
+    pushl %eax
+    popfl
+    pushfl
+    popl %eax
+    pushl %ecx
+    popfl
+    xorl %ecx, %eax
+    testl $0x200000, %eax
+    jz .fpu_done
+
+    pushl %ebx
+    movl $1, %eax
+    cpuid
+    popl %ebx
+    andl $0x03000000, %edx        # FXSR | SSE
+    cmpl $0x03000000, %edx
+    jne .fpu_done
+    movl %cr4, %eax
+    orl $0x600, %eax              # OSFXSR | OSXMMEXCPT
+    movl %eax, %cr4
+    movl $1, sse_enabled
+    jmp .fpu_done
+.no_fpu:
+    movl %cr0, %eax
+    andl $~0x02, %eax             # clear MP
+    orl $0x04, %eax               # set EM
+    movl %eax, %cr0
+.fpu_done:
+    ret
+
+# Interrupt entry stubs. Each pushes a dummy error code when the CPU does
+# not push one, then its vector, so isr_dispatch always sees the same frame.
+.macro ISR_NOERR num
+isr_stub_\num:
+    pushl $0
+    pushl $\num
+    jmp isr_common
+.endm
+
+.macro ISR_ERR num
+isr_stub_\num:
+    pushl $\num
+    jmp isr_common
+.endm
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR   8
+ISR_NOERR 9
+ISR_ERR   10
+ISR_ERR   11
+ISR_ERR   12
+ISR_ERR   13
+ISR_ERR   14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR   17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_NOERR 21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_NOERR 29
+ISR_ERR   30
+ISR_NOERR 31
+ISR_NOERR 32
+ISR_NOERR 33
+ISR_NOERR 34
+ISR_NOERR 35
+ISR_NOERR 36
+ISR_NOERR 37
+ISR_NOERR 38
+ISR_NOERR 39
+ISR_NOERR 40
+ISR_NOERR 41
+ISR_NOERR 42
+ISR_NOERR 43
+ISR_NOERR 44
+ISR_NOERR 45
+ISR_NOERR 46
+ISR_NOERR 47
+
+.extern isr_dispatch
+isr_common:
+    pushal
+    rdtsc                         # entry stamp for per-IRQ time, EAX/EDX are saved by now
+    movl %eax, isr_entry_tsc
+    movl %edx, isr_entry_tsc+4
+    cld
+    movl %esp, %esi               # struct interrupt_frame*, callee-saved across the call
+    andl $-16, %esp               # interrupts arrive at any alignment; C code assumes
+    subl $12, %esp                # esp is 16-byte aligned at each call
+    pushl %esi
+    call isr_dispatch
+    movl %esi, %esp
+    popal
+    addl $8, %esp                 # vector and error code
+    iret
+
+.section .rodata
+.global isr_stub_table
+isr_stub_table:
+.irp num, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47
+    .long isr_stub_\num
+.endr
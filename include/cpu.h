@@ -0,0 +1,91 @@
+#ifndef MINIMAL_CPU_H
+#define MINIMAL_CPU_H
+
+#include <stdint.h>
+
+// CPUID leaf 1 EDX feature bits
+#define CPUID_EDX_FPU  (1u << 0)
+#define CPUID_EDX_TSC  (1u << 4)
+#define CPUID_EDX_MMX  (1u << 23)
+#define CPUID_EDX_FXSR (1u << 24)
+#define CPUID_EDX_SSE  (1u << 25)
+#define CPUID_EDX_SSE2 (1u << 26)
+
+// Control register bits
+#define CR0_MP (1u << 1)
+#define CR0_EM (1u << 2)
+#define CR0_TS (1u << 3)
+#define CR0_NE (1u << 5)
+#define CR4_OSFXSR     (1u << 9)
+#define CR4_OSXMMEXCPT (1u << 10)
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+// cpu_has_cpuid: true if EFLAGS.ID can be toggled (not on 386 and early 486)
+static inline int cpu_has_cpuid(void) {
+    uint32_t before, after;
+    __asm__ volatile (
+        "pushfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %0\n\t"
+        "pushl %0\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "popfl"
+        : "=&r"(after), "=&r"(before));
+    return ((after ^ before) & 0x200000) != 0;
+}
+
+// cpu_features: CPUID leaf 1 EDX, or 0 when CPUID is missing
+static inline uint32_t cpu_features(void) {
+    static int probed = 0;
+    static uint32_t edx = 0;
+    if (!probed) {
+        probed = 1;
+        if (cpu_has_cpuid()) {
+            uint32_t a, b, c, max;
+            cpuid(0, &max, &b, &c, &a);
+            if (max >= 1) cpuid(1, &a, &b, &c, &edx);
+        }
+    }
+    return edx;
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile ("movl %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ volatile ("movl %0, %%cr4" : : "r"(v) : "memory");
+}
+
+// cpu_can_use_mmx: MMX present and not trapped by CR0.EM
+static inline int cpu_can_use_mmx(void) {
+    return (cpu_features() & CPUID_EDX_MMX) && !(read_cr0() & CR0_EM);
+}
+
+// cpu_can_use_sse2: SSE2 present and the kernel has enabled FXSAVE/SSE in CR4
+static inline int cpu_can_use_sse2(void) {
+    uint32_t f = cpu_features();
+    if (!(f & CPUID_EDX_SSE2) || !(f & CPUID_EDX_FXSR)) return 0;
+    return (read_cr4() & CR4_OSFXSR) && !(read_cr0() & CR0_EM);
+}
+
+#endif // MINIMAL_CPU_H
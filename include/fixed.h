@@ -0,0 +1,118 @@
+#ifndef MINIMAL_FIXED_H
+#define MINIMAL_FIXED_H
+
+#include <stdint.h>
+#include <fixed_tables.h>
+
+/*
+ * 16.16 fixed point for animation without an FPU. Angles are integers with
+ * FIX_ANGLES steps per turn, so sine and cosine are one table load, and
+ * division by a small integer is a multiply by a reciprocal; both tables
+ * are generated ahead of time by tools/fixed_tables.py. Products go through
+ * 64 bits, which i386 does with one widening imul.
+ *
+ * fix_transform_points maps a whole array of model vertices through one
+ * rotate/scale/translate matrix in a single pass, ending in rounded screen
+ * coordinates ready for draw_triangle, draw_line or fill_polygon.
+ */
+
+#define FIX_SHIFT 16
+#define FIX_ONE   (1 << FIX_SHIFT)
+#define FIX_HALF  (1 << (FIX_SHIFT - 1))
+
+// A 16.16 vector, model space
+struct fix_vec2 {
+    int32_t x, y;
+};
+
+// A rounded pixel position, screen space
+struct fix_point {
+    int x, y;
+};
+
+// x' = xx * x + xy * y + tx, y' = yx * x + yy * y + ty, all 16.16
+struct fix_transform {
+    int32_t xx, xy, yx, yy;
+    int32_t tx, ty;
+};
+
+static inline int32_t fix_from_int(int v) {
+    return (int32_t)v * FIX_ONE;
+}
+
+// fix_to_int: rounds down; fix_round: to nearest
+static inline int fix_to_int(int32_t v) {
+    return v >> FIX_SHIFT;
+}
+
+static inline int fix_round(int32_t v) {
+    return (v + FIX_HALF) >> FIX_SHIFT;
+}
+
+static inline int32_t fix_mul(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> FIX_SHIFT);
+}
+
+// fix_div_int: a / n rounded toward zero like C division, 0 for n = 0. Up to
+// FIX_RECIP_MAX it is a multiply by the reciprocal plus one to correct it.
+static inline int32_t fix_div_int(int32_t a, int n) {
+    if (n == 0) return 0;
+    if (n < 0) {
+        a = -a;
+        n = -n;
+    }
+    if (n > FIX_RECIP_MAX) return a / n;
+    uint32_t u = a < 0 ? -(uint32_t)a : (uint32_t)a;
+    uint32_t q = n == 1 ? u : (uint32_t)(((uint64_t)u * fix_recip_table[n]) >> 32);
+    if ((uint64_t)q * (uint32_t)n > u) q--;
+    return a < 0 ? -(int32_t)q : (int32_t)q;
+}
+
+static inline int32_t fix_sin(int angle) {
+    return fix_sin_table[angle & (FIX_ANGLES - 1)];
+}
+
+static inline int32_t fix_cos(int angle) {
+    return fix_sin_table[(angle + FIX_ANGLES / 4) & (FIX_ANGLES - 1)];
+}
+
+// fix_transform_set: rotate by angle, scale, then move the origin to (tx, ty)
+static inline void fix_transform_set(struct fix_transform *t, int angle, int32_t scale, int32_t tx, int32_t ty) {
+    int32_t c = fix_mul(fix_cos(angle), scale);
+    int32_t s = fix_mul(fix_sin(angle), scale);
+    t->xx = c;
+    t->xy = -s;
+    t->yx = s;
+    t->yy = c;
+    t->tx = tx;
+    t->ty = ty;
+}
+
+// fix_transform_combine: out = outer after inner (out may alias either)
+static inline void fix_transform_combine(struct fix_transform *out, const struct fix_transform *outer,
+                                         const struct fix_transform *inner) {
+    struct fix_transform r;
+    r.xx = fix_mul(outer->xx, inner->xx) + fix_mul(outer->xy, inner->yx);
+    r.xy = fix_mul(outer->xx, inner->xy) + fix_mul(outer->xy, inner->yy);
+    r.yx = fix_mul(outer->yx, inner->xx) + fix_mul(outer->yy, inner->yx);
+    r.yy = fix_mul(outer->yx, inner->xy) + fix_mul(outer->yy, inner->yy);
+    r.tx = fix_mul(outer->xx, inner->tx) + fix_mul(outer->xy, inner->ty) + outer->tx;
+    r.ty = fix_mul(outer->yx, inner->tx) + fix_mul(outer->yy, inner->ty) + outer->ty;
+    *out = r;
+}
+
+// fix_transform_points: n vertices through t into out[0..n-1] as rounded pixels
+static inline void fix_transform_points(const struct fix_transform *t, const struct fix_vec2 *in, struct fix_point *out,
+                                        int n) {
+    const int32_t xx = t->xx, xy = t->xy, yx = t->yx, yy = t->yy;
+    const int64_t tx = (int64_t)t->tx * FIX_ONE, ty = (int64_t)t->ty * FIX_ONE;
+    const int64_t half = (int64_t)FIX_HALF * FIX_ONE;
+    for (int i = 0; i < n; i++) {
+        int64_t x = (int64_t)xx * in[i].x + (int64_t)xy * in[i].y + tx + half;
+        int64_t y = (int64_t)yx * in[i].x + (int64_t)yy * in[i].y + ty + half;
+        out[i].x = (int)(x >> (2 * FIX_SHIFT));
+        out[i].y = (int)(y >> (2 * FIX_SHIFT));
+    }
+}
+
+#endif // MINIMAL_FIXED_H
@@ -0,0 +1,316 @@
+#ifndef MINIMAL_FIXED_TABLES_H
+#define MINIMAL_FIXED_TABLES_H
+
+// Generated by tools/fixed_tables.py, do not edit
+
+#include <stdint.h>
+
+#define FIX_ANGLES    1024
+#define FIX_RECIP_MAX 1024
+
+static const int32_t fix_sin_table[FIX_ANGLES] = {
+    0, 402, 804, 1206, 1608, 2010, 2412, 2814,
+    3216, 3617, 4019, 4420, 4821, 5222, 5623, 6023,
+    6424, 6824, 7224, 7623, 8022, 8421, 8820, 9218,
+    9616, 10014, 10411, 10808, 11204, 11600, 11996, 12391,
+    12785, 13180, 13573, 13966, 14359, 14751, 15143, 15534,
+    15924, 16314, 16703, 17091, 17479, 17867, 18253, 18639,
+    19024, 19409, 19792, 20175, 20557, 20939, 21320, 21699,
+    22078, 22457, 22834, 23210, 23586, 23961, 24335, 24708,
+    25080, 25451, 25821, 26190, 26558, 26925, 27291, 27656,
+    28020, 28383, 28745, 29106, 29466, 29824, 30182, 30538,
+    30893, 31248, 31600, 31952, 32303, 32652, 33000, 33347,
+    33692, 34037, 34380, 34721, 35062, 35401, 35738, 36075,
+    36410, 36744, 37076, 37407, 37736, 38064, 38391, 38716,
+    39040, 39362, 39683, 40002, 40320, 40636, 40951, 41264,
+    41576, 41886, 42194, 42501, 42806, 43110, 43412, 43713,
+    44011, 44308, 44604, 44898, 45190, 45480, 45769, 46056,
+    46341, 46624, 46906, 47186, 47464, 47741, 48015, 48288,
+    48559, 48828, 49095, 49361, 49624, 49886, 50146, 50404,
+    50660, 50914, 51166, 51417, 51665, 51911, 52156, 52398,
+    52639, 52878, 53114, 53349, 53581, 53812, 54040, 54267,
+    54491, 54714, 54934, 55152, 55368, 55582, 55794, 56004,
+    56212, 56418, 56621, 56823, 57022, 57219, 57414, 57607,
+    57798, 57986, 58172, 58356, 58538, 58718, 58896, 59071,
+    59244, 59415, 59583, 59750, 59914, 60075, 60235, 60392,
+    60547, 60700, 60851, 60999, 61145, 61288, 61429, 61568,
+    61705, 61839, 61971, 62101, 62228, 62353, 62476, 62596,
+    62714, 62830, 62943, 63054, 63162, 63268, 63372, 63473,
+    63572, 63668, 63763, 63854, 63944, 64031, 64115, 64197,
+    64277, 64354, 64429, 64501, 64571, 64639, 64704, 64766,
+    64827, 64884, 64940, 64993, 65043, 65091, 65137, 65180,
+    65220, 65259, 65294, 65328, 65358, 65387, 65413, 65436,
+    65457, 65476, 65492, 65505, 65516, 65525, 65531, 65535,
+    65536, 65535, 65531, 65525, 65516, 65505, 65492, 65476,
+    65457, 65436, 65413, 65387, 65358, 65328, 65294, 65259,
+    65220, 65180, 65137, 65091, 65043, 64993, 64940, 64884,
+    64827, 64766, 64704, 64639, 64571, 64501, 64429, 64354,
+    64277, 64197, 64115, 64031, 63944, 63854, 63763, 63668,
+    63572, 63473, 63372, 63268, 63162, 63054, 62943, 62830,
+    62714, 62596, 62476, 62353, 62228, 62101, 61971, 61839,
+    61705, 61568, 61429, 61288, 61145, 60999, 60851, 60700,
+    60547, 60392, 60235, 60075, 59914, 59750, 59583, 59415,
+    59244, 59071, 58896, 58718, 58538, 58356, 58172, 57986,
+    57798, 57607, 57414, 57219, 57022, 56823, 56621, 56418,
+    56212, 56004, 55794, 55582, 55368, 55152, 54934, 54714,
+    54491, 54267, 54040, 53812, 53581, 53349, 53114, 52878,
+    52639, 52398, 52156, 51911, 51665, 51417, 51166, 50914,
+    50660, 50404, 50146, 49886, 49624, 49361, 49095, 48828,
+    48559, 48288, 48015, 47741, 47464, 47186, 46906, 46624,
+    46341, 46056, 45769, 45480, 45190, 44898, 44604, 44308,
+    44011, 43713, 43412, 43110, 42806, 42501, 42194, 41886,
+    41576, 41264, 40951, 40636, 40320, 40002, 39683, 39362,
+    39040, 38716, 38391, 38064, 37736, 37407, 37076, 36744,
+    36410, 36075, 35738, 35401, 35062, 34721, 34380, 34037,
+    33692, 33347, 33000, 32652, 32303, 31952, 31600, 31248,
+    30893, 30538, 30182, 29824, 29466, 29106, 28745, 28383,
+    28020, 27656, 27291, 26925, 26558, 26190, 25821, 25451,
+    25080, 24708, 24335, 23961, 23586, 23210, 22834, 22457,
+    22078, 21699, 21320, 20939, 20557, 20175, 19792, 19409,
+    19024, 18639, 18253, 17867, 17479, 17091, 16703, 16314,
+    15924, 15534, 15143, 14751, 14359, 13966, 13573, 13180,
+    12785, 12391, 11996, 11600, 11204, 10808, 10411, 10014,
+    9616, 9218, 8820, 8421, 8022, 7623, 7224, 6824,
+    6424, 6023, 5623, 5222, 4821, 4420, 4019, 3617,
+    3216, 2814, 2412, 2010, 1608, 1206, 804, 402,
+    0, -402, -804, -1206, -1608, -2010, -2412, -2814,
+    -3216, -3617, -4019, -4420, -4821, -5222, -5623, -6023,
+    -6424, -6824, -7224, -7623, -8022, -8421, -8820, -9218,
+    -9616, -10014, -10411, -10808, -11204, -11600, -11996, -12391,
+    -12785, -13180, -13573, -13966, -14359, -14751, -15143, -15534,
+    -15924, -16314, -16703, -17091, -17479, -17867, -18253, -18639,
+    -19024, -19409, -19792, -20175, -20557, -20939, -21320, -21699,
+    -22078, -22457, -22834, -23210, -23586, -23961, -24335, -24708,
+    -25080, -25451, -25821, -26190, -26558, -26925, -27291, -27656,
+    -28020, -28383, -28745, -29106, -29466, -29824, -30182, -30538,
+    -30893, -31248, -31600, -31952, -32303, -32652, -33000, -33347,
+    -33692, -34037, -34380, -34721, -35062, -35401, -35738, -36075,
+    -36410, -36744, -37076, -37407, -37736, -38064, -38391, -38716,
+    -39040, -39362, -39683, -40002, -40320, -40636, -40951, -41264,
+    -41576, -41886, -42194, -42501, -42806, -43110, -43412, -43713,
+    -44011, -44308, -44604, -44898, -45190, -45480, -45769, -46056,
+    -46341, -46624, -46906, -47186, -47464, -47741, -48015, -48288,
+    -48559, -48828, -49095, -49361, -49624, -49886, -50146, -50404,
+    -50660, -50914, -51166, -51417, -51665, -51911, -52156, -52398,
+    -52639, -52878, -53114, -53349, -53581, -53812, -54040, -54267,
+    -54491, -54714, -54934, -55152, -55368, -55582, -55794, -56004,
+    -56212, -56418, -56621, -56823, -57022, -57219, -57414, -57607,
+    -57798, -57986, -58172, -58356, -58538, -58718, -58896, -59071,
+    -59244, -59415, -59583, -59750, -59914, -60075, -60235, -60392,
+    -60547, -60700, -60851, -60999, -61145, -61288, -61429, -61568,
+    -61705, -61839, -61971, -62101, -62228, -62353, -62476, -62596,
+    -62714, -62830, -62943, -63054, -63162, -63268, -63372, -63473,
+    -63572, -63668, -63763, -63854, -63944, -64031, -64115, -64197,
+    -64277, -64354, -64429, -64501, -64571, -64639, -64704, -64766,
+    -64827, -64884, -64940, -64993, -65043, -65091, -65137, -65180,
+    -65220, -65259, -65294, -65328, -65358, -65387, -65413, -65436,
+    -65457, -65476, -65492, -65505, -65516, -65525, -65531, -65535,
+    -65536, -65535, -65531, -65525, -65516, -65505, -65492, -65476,
+    -65457, -65436, -65413, -65387, -65358, -65328, -65294, -65259,
+    -65220, -65180, -65137, -65091, -65043, -64993, -64940, -64884,
+    -64827, -64766, -64704, -64639, -64571, -64501, -64429, -64354,
+    -64277, -64197, -64115, -64031, -63944, -63854, -63763, -63668,
+    -63572, -63473, -63372, -63268, -63162, -63054, -62943, -62830,
+    -62714, -62596, -62476, -62353, -62228, -62101, -61971, -61839,
+    -61705, -61568, -61429, -61288, -61145, -60999, -60851, -60700,
+    -60547, -60392, -60235, -60075, -59914, -59750, -59583, -59415,
+    -59244, -59071, -58896, -58718, -58538, -58356, -58172, -57986,
+    -57798, -57607, -57414, -57219, -57022, -56823, -56621, -56418,
+    -56212, -56004, -55794, -55582, -55368, -55152, -54934, -54714,
+    -54491, -54267, -54040, -53812, -53581, -53349, -53114, -52878,
+    -52639, -52398, -52156, -51911, -51665, -51417, -51166, -50914,
+    -50660, -50404, -50146, -49886, -49624, -49361, -49095, -48828,
+    -48559, -48288, -48015, -47741, -47464, -47186, -46906, -46624,
+    -46341, -46056, -45769, -45480, -45190, -44898, -44604, -44308,
+    -44011, -43713, -43412, -43110, -42806, -42501, -42194, -41886,
+    -41576, -41264, -40951, -40636, -40320, -40002, -39683, -39362,
+    -39040, -38716, -38391, -38064, -37736, -37407, -37076, -36744,
+    -36410, -36075, -35738, -35401, -35062, -34721, -34380, -34037,
+    -33692, -33347, -33000, -32652, -32303, -31952, -31600, -31248,
+    -30893, -30538, -30182, -29824, -29466, -29106, -28745, -28383,
+    -28020, -27656, -27291, -26925, -26558, -26190, -25821, -25451,
+    -25080, -24708, -24335, -23961, -23586, -23210, -22834, -22457,
+    -22078, -21699, -21320, -20939, -20557, -20175, -19792, -19409,
+    -19024, -18639, -18253, -17867, -17479, -17091, -16703, -16314,
+    -15924, -15534, -15143, -14751, -14359, -13966, -13573, -13180,
+    -12785, -12391, -11996, -11600, -11204, -10808, -10411, -10014,
+    -9616, -9218, -8820, -8421, -8022, -7623, -7224, -6824,
+    -6424, -6023, -5623, -5222, -4821, -4420, -4019, -3617,
+    -3216, -2814, -2412, -2010, -1608, -1206, -804, -402,
+};
+
+static const uint32_t fix_recip_table[FIX_RECIP_MAX + 1] = {
+    0u, 0u, 2147483648u, 1431655766u, 1073741824u, 858993460u,
+    715827883u, 613566757u, 536870912u, 477218589u, 429496730u, 390451573u,
+    357913942u, 330382100u, 306783379u, 286331154u, 268435456u, 252645136u,
+    238609295u, 226050911u, 214748365u, 204522253u, 195225787u, 186737709u,
+    178956971u, 171798692u, 165191050u, 159072863u, 153391690u, 148102321u,
+    143165577u, 138547333u, 134217728u, 130150525u, 126322568u, 122713352u,
+    119304648u, 116080198u, 113025456u, 110127367u, 107374183u, 104755300u,
+    102261127u, 99882961u, 97612894u, 95443718u, 93368855u, 91382283u,
+    89478486u, 87652394u, 85899346u, 84215046u, 82595525u, 81037119u,
+    79536432u, 78090315u, 76695845u, 75350304u, 74051161u, 72796056u,
+    71582789u, 70409300u, 69273667u, 68174085u, 67108864u, 66076420u,
+    65075263u, 64103990u, 63161284u, 62245903u, 61356676u, 60492498u,
+    59652324u, 58835169u, 58040099u, 57266231u, 56512728u, 55778797u,
+    55063684u, 54366675u, 53687092u, 53024288u, 52377650u, 51746594u,
+    51130564u, 50529028u, 49941481u, 49367441u, 48806447u, 48258060u,
+    47721859u, 47197443u, 46684428u, 46182445u, 45691142u, 45210183u,
+    44739243u, 44278014u, 43826197u, 43383509u, 42949673u, 42524429u,
+    42107523u, 41698712u, 41297763u, 40904451u, 40518560u, 40139882u,
+    39768216u, 39403370u, 39045158u, 38693400u, 38347923u, 38008561u,
+    37675152u, 37347542u, 37025581u, 36709123u, 36398028u, 36092163u,
+    35791395u, 35495598u, 35204650u, 34918434u, 34636834u, 34359739u,
+    34087043u, 33818641u, 33554432u, 33294321u, 33038210u, 32786010u,
+    32537632u, 32292988u, 32051995u, 31814573u, 31580642u, 31350127u,
+    31122952u, 30899046u, 30678338u, 30460761u, 30246249u, 30034737u,
+    29826162u, 29620465u, 29417585u, 29217465u, 29020050u, 28825284u,
+    28633116u, 28443493u, 28256364u, 28071682u, 27889399u, 27709467u,
+    27531842u, 27356480u, 27183338u, 27012373u, 26843546u, 26676816u,
+    26512144u, 26349493u, 26188825u, 26030105u, 25873297u, 25718368u,
+    25565282u, 25414008u, 25264514u, 25116768u, 24970741u, 24826401u,
+    24683721u, 24542671u, 24403224u, 24265352u, 24129030u, 23994231u,
+    23860930u, 23729102u, 23598722u, 23469767u, 23342214u, 23216040u,
+    23091223u, 22967740u, 22845571u, 22724695u, 22605092u, 22486740u,
+    22369622u, 22253717u, 22139007u, 22025474u, 21913099u, 21801865u,
+    21691755u, 21582751u, 21474837u, 21367997u, 21262215u, 21157475u,
+    21053762u, 20951060u, 20849356u, 20748635u, 20648882u, 20550083u,
+    20452226u, 20355296u, 20259280u, 20164166u, 20069941u, 19976593u,
+    19884108u, 19792477u, 19701685u, 19611723u, 19522579u, 19434242u,
+    19346700u, 19259944u, 19173962u, 19088744u, 19004281u, 18920561u,
+    18837576u, 18755316u, 18673771u, 18592933u, 18512791u, 18433337u,
+    18354562u, 18276457u, 18199014u, 18122225u, 18046082u, 17970575u,
+    17895698u, 17821442u, 17747799u, 17674763u, 17602325u, 17530479u,
+    17459217u, 17388532u, 17318417u, 17248865u, 17179870u, 17111424u,
+    17043522u, 16976156u, 16909321u, 16843010u, 16777216u, 16711936u,
+    16647161u, 16582886u, 16519105u, 16455814u, 16393005u, 16330675u,
+    16268816u, 16207424u, 16146494u, 16086020u, 16025998u, 15966422u,
+    15907287u, 15848588u, 15790321u, 15732481u, 15675064u, 15618063u,
+    15561476u, 15505298u, 15449523u, 15394149u, 15339169u, 15284582u,
+    15230381u, 15176563u, 15123125u, 15070061u, 15017369u, 14965043u,
+    14913081u, 14861479u, 14810233u, 14759338u, 14708793u, 14658592u,
+    14608733u, 14559212u, 14510025u, 14461170u, 14412642u, 14364440u,
+    14316558u, 14268995u, 14221747u, 14174810u, 14128182u, 14081860u,
+    14035841u, 13990122u, 13944700u, 13899571u, 13854734u, 13810185u,
+    13765921u, 13721941u, 13678240u, 13634817u, 13591669u, 13548793u,
+    13506187u, 13463848u, 13421773u, 13379961u, 13338408u, 13297113u,
+    13256072u, 13215284u, 13174747u, 13134457u, 13094413u, 13054612u,
+    13015053u, 12975733u, 12936649u, 12897800u, 12859184u, 12820798u,
+    12782641u, 12744711u, 12707004u, 12669521u, 12632257u, 12595213u,
+    12558384u, 12521771u, 12485371u, 12449181u, 12413201u, 12377428u,
+    12341861u, 12306497u, 12271336u, 12236375u, 12201612u, 12167047u,
+    12132676u, 12098500u, 12064515u, 12030721u, 11997116u, 11963698u,
+    11930465u, 11897417u, 11864551u, 11831866u, 11799361u, 11767034u,
+    11734884u, 11702909u, 11671107u, 11639478u, 11608020u, 11576732u,
+    11545612u, 11514658u, 11483870u, 11453247u, 11422786u, 11392487u,
+    11362348u, 11332368u, 11302546u, 11272881u, 11243370u, 11214014u,
+    11184811u, 11155760u, 11126859u, 11098107u, 11069504u, 11041048u,
+    11012737u, 10984572u, 10956550u, 10928670u, 10900933u, 10873335u,
+    10845878u, 10818558u, 10791376u, 10764330u, 10737419u, 10710642u,
+    10683999u, 10657488u, 10631108u, 10604858u, 10578738u, 10552746u,
+    10526881u, 10501143u, 10475530u, 10450043u, 10424678u, 10399437u,
+    10374318u, 10349319u, 10324441u, 10299682u, 10275042u, 10250519u,
+    10226113u, 10201823u, 10177648u, 10153587u, 10129640u, 10105806u,
+    10082083u, 10058472u, 10034971u, 10011579u, 9988297u, 9965122u,
+    9942054u, 9919094u, 9896239u, 9873489u, 9850843u, 9828301u,
+    9805862u, 9783525u, 9761290u, 9739155u, 9717121u, 9695186u,
+    9673350u, 9651612u, 9629972u, 9608428u, 9586981u, 9565629u,
+    9544372u, 9523210u, 9502141u, 9481165u, 9460281u, 9439489u,
+    9418788u, 9398178u, 9377658u, 9357228u, 9336886u, 9316632u,
+    9296467u, 9276388u, 9256396u, 9236489u, 9216669u, 9196933u,
+    9177281u, 9157713u, 9138229u, 9118827u, 9099507u, 9080270u,
+    9061113u, 9042037u, 9023041u, 9004125u, 8985288u, 8966529u,
+    8947849u, 8929246u, 8910721u, 8892272u, 8873900u, 8855603u,
+    8837382u, 8819235u, 8801163u, 8783165u, 8765240u, 8747388u,
+    8729609u, 8711902u, 8694266u, 8676702u, 8659209u, 8641786u,
+    8624433u, 8607149u, 8589935u, 8572790u, 8555712u, 8538703u,
+    8521761u, 8504886u, 8488078u, 8471336u, 8454661u, 8438050u,
+    8421505u, 8405025u, 8388608u, 8372256u, 8355968u, 8339743u,
+    8323581u, 8307481u, 8291443u, 8275467u, 8259553u, 8243700u,
+    8227907u, 8212175u, 8196503u, 8180891u, 8165338u, 8149844u,
+    8134408u, 8119031u, 8103712u, 8088451u, 8073247u, 8058100u,
+    8043010u, 8027977u, 8012999u, 7998077u, 7983211u, 7968400u,
+    7953644u, 7938942u, 7924294u, 7909701u, 7895161u, 7880674u,
+    7866241u, 7851860u, 7837532u, 7823256u, 7809032u, 7794859u,
+    7780738u, 7766668u, 7752649u, 7738680u, 7724762u, 7710893u,
+    7697075u, 7683305u, 7669585u, 7655914u, 7642291u, 7628717u,
+    7615191u, 7601713u, 7588282u, 7574899u, 7561563u, 7548273u,
+    7535031u, 7521835u, 7508685u, 7495580u, 7482522u, 7469509u,
+    7456541u, 7443618u, 7430740u, 7417906u, 7405117u, 7392371u,
+    7379669u, 7367011u, 7354397u, 7341825u, 7329296u, 7316810u,
+    7304367u, 7291965u, 7279606u, 7267289u, 7255013u, 7242778u,
+    7230585u, 7218433u, 7206321u, 7194251u, 7182220u, 7170230u,
+    7158279u, 7146369u, 7134498u, 7122666u, 7110874u, 7099120u,
+    7087405u, 7075729u, 7064091u, 7052492u, 7040930u, 7029407u,
+    7017921u, 7006472u, 6995061u, 6983687u, 6972350u, 6961050u,
+    6949786u, 6938558u, 6927367u, 6916212u, 6905093u, 6894009u,
+    6882961u, 6871948u, 6860971u, 6850028u, 6839120u, 6828247u,
+    6817409u, 6806605u, 6795835u, 6785099u, 6774397u, 6763729u,
+    6753094u, 6742492u, 6731924u, 6721389u, 6710887u, 6700417u,
+    6689981u, 6679576u, 6669204u, 6658865u, 6648557u, 6638281u,
+    6628036u, 6617824u, 6607642u, 6597493u, 6587374u, 6577286u,
+    6567229u, 6557202u, 6547207u, 6537241u, 6527306u, 6517402u,
+    6507527u, 6497682u, 6487867u, 6478081u, 6468325u, 6458598u,
+    6448900u, 6439232u, 6429592u, 6419982u, 6410399u, 6400846u,
+    6391321u, 6381824u, 6372356u, 6362915u, 6353502u, 6344118u,
+    6334761u, 6325431u, 6316129u, 6306854u, 6297607u, 6288386u,
+    6279192u, 6270026u, 6260886u, 6251772u, 6242686u, 6233625u,
+    6224591u, 6215583u, 6206601u, 6197645u, 6188714u, 6179810u,
+    6170931u, 6162077u, 6153249u, 6144446u, 6135668u, 6126915u,
+    6118188u, 6109485u, 6100806u, 6092153u, 6083524u, 6074919u,
+    6066338u, 6057782u, 6049250u, 6040742u, 6032258u, 6023798u,
+    6015361u, 6006948u, 5998558u, 5990192u, 5981849u, 5973529u,
+    5965233u, 5956959u, 5948709u, 5940481u, 5932276u, 5924093u,
+    5915933u, 5907796u, 5899681u, 5891588u, 5883517u, 5875469u,
+    5867442u, 5859437u, 5851455u, 5843493u, 5835554u, 5827636u,
+    5819739u, 5811864u, 5804010u, 5796178u, 5788366u, 5780576u,
+    5772806u, 5765057u, 5757329u, 5749622u, 5741935u, 5734269u,
+    5726624u, 5718998u, 5711393u, 5703808u, 5696244u, 5688699u,
+    5681174u, 5673669u, 5666184u, 5658719u, 5651273u, 5643847u,
+    5636441u, 5629053u, 5621685u, 5614337u, 5607007u, 5599697u,
+    5592406u, 5585134u, 5577880u, 5570646u, 5563430u, 5556232u,
+    5549054u, 5541894u, 5534752u, 5527629u, 5520524u, 5513437u,
+    5506369u, 5499318u, 5492286u, 5485272u, 5478275u, 5471296u,
+    5464335u, 5457392u, 5450467u, 5443559u, 5436668u, 5429795u,
+    5422939u, 5416100u, 5409279u, 5402475u, 5395688u, 5388918u,
+    5382165u, 5375429u, 5368710u, 5362007u, 5355321u, 5348652u,
+    5342000u, 5335364u, 5328744u, 5322141u, 5315554u, 5308984u,
+    5302429u, 5295891u, 5289369u, 5282863u, 5276373u, 5269899u,
+    5263441u, 5256998u, 5250572u, 5244161u, 5237765u, 5231386u,
+    5225022u, 5218673u, 5212339u, 5206021u, 5199719u, 5193431u,
+    5187159u, 5180902u, 5174660u, 5168433u, 5162221u, 5156024u,
+    5149841u, 5143674u, 5137521u, 5131383u, 5125260u, 5119151u,
+    5113057u, 5106977u, 5100912u, 5094861u, 5088824u, 5082802u,
+    5076794u, 5070800u, 5064820u, 5058855u, 5052903u, 5046966u,
+    5041042u, 5035132u, 5029236u, 5023354u, 5017486u, 5011631u,
+    5005790u, 4999962u, 4994149u, 4988348u, 4982561u, 4976788u,
+    4971027u, 4965281u, 4959547u, 4953827u, 4948120u, 4942425u,
+    4936745u, 4931077u, 4925422u, 4919780u, 4914151u, 4908535u,
+    4902931u, 4897341u, 4891763u, 4886198u, 4880645u, 4875105u,
+    4869578u, 4864063u, 4858561u, 4853071u, 4847593u, 4842128u,
+    4836675u, 4831235u, 4825806u, 4820390u, 4814986u, 4809594u,
+    4804214u, 4798847u, 4793491u, 4788147u, 4782815u, 4777495u,
+    4772186u, 4766890u, 4761605u, 4756332u, 4751071u, 4745821u,
+    4740583u, 4735356u, 4730141u, 4724937u, 4719745u, 4714564u,
+    4709394u, 4704236u, 4699089u, 4693954u, 4688829u, 4683716u,
+    4678614u, 4673523u, 4668443u, 4663374u, 4658316u, 4653270u,
+    4648234u, 4643208u, 4638194u, 4633191u, 4628198u, 4623216u,
+    4618245u, 4613284u, 4608335u, 4603395u, 4598467u, 4593548u,
+    4588641u, 4583744u, 4578857u, 4573981u, 4569115u, 4564259u,
+    4559414u, 4554579u, 4549754u, 4544939u, 4540135u, 4535341u,
+    4530557u, 4525783u, 4521019u, 4516265u, 4511521u, 4506787u,
+    4502063u, 4497348u, 4492644u, 4487950u, 4483265u, 4478590u,
+    4473925u, 4469269u, 4464623u, 4459987u, 4455361u, 4450744u,
+    4446136u, 4441539u, 4436950u, 4432371u, 4427802u, 4423242u,
+    4418691u, 4414150u, 4409618u, 4405095u, 4400582u, 4396078u,
+    4391583u, 4387097u, 4382620u, 4378153u, 4373694u, 4369245u,
+    4364805u, 4360373u, 4355951u, 4351538u, 4347133u, 4342738u,
+    4338351u, 4333974u, 4329605u, 4325245u, 4320893u, 4316551u,
+    4312217u, 4307891u, 4303575u, 4299267u, 4294968u, 4290677u,
+    4286395u, 4282121u, 4277856u, 4273600u, 4269352u, 4265112u,
+    4260881u, 4256658u, 4252443u, 4248237u, 4244039u, 4239850u,
+    4235668u, 4231495u, 4227331u, 4223174u, 4219025u, 4214885u,
+    4210753u, 4206629u, 4202513u, 4198405u, 4194304u,
+};
+
+#endif // MINIMAL_FIXED_TABLES_H
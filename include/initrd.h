@@ -0,0 +1,215 @@
+#ifndef MINIMAL_INITRD_H
+#define MINIMAL_INITRD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Read-only initrd: a ustar archive loaded as a Multiboot module. initrd_init
+ * walks the archive once and builds a path hash table plus a child list per
+ * directory; after that lookups never touch the archive again, and file data
+ * is handed out as pointers into the module.
+ *
+ * Paths are stored without leading "/" or "./" and without a trailing "/".
+ * The root directory is entry 0 with the empty path. Directories the archive
+ * only implies (e.g. "a/b" from "a/b/c.txt") are created as well.
+ */
+
+#define INITRD_MAX_FILES  256
+#define INITRD_TABLE_SIZE (INITRD_MAX_FILES * 2) // power of two, kept half empty
+#define INITRD_NAME_POOL  (INITRD_MAX_FILES * 32)
+#define INITRD_BLOCK      512
+#define INITRD_NONE       0xFFFF
+
+#define INITRD_FILE 0
+#define INITRD_DIR  1
+
+struct initrd_file {
+    const char *path;
+    const char *name;     // last path component
+    const uint8_t *data;  // inside the module, NULL for directories
+    uint32_t size;
+    uint32_t hash;
+    uint16_t path_len;
+    uint8_t type;
+    uint16_t parent;
+    uint16_t first_child; // INITRD_NONE when empty
+    uint16_t last_child;
+    uint16_t next_sibling;
+};
+
+static struct initrd_file initrd_files[INITRD_MAX_FILES];
+static int initrd_file_count = 0;
+static uint16_t initrd_table[INITRD_TABLE_SIZE]; // index + 1, 0 = empty slot
+static char initrd_names[INITRD_NAME_POOL];
+static uint32_t initrd_names_used = 0;
+
+// initrd_hash: FNV-1a over len bytes of a path
+static inline uint32_t initrd_hash(const char *s, uint32_t len) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline int initrd_path_equal(const struct initrd_file *f, const char *s, uint32_t len) {
+    if (f->path_len != len) return 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (f->path[i] != s[i]) return 0;
+    }
+    return 1;
+}
+
+// Strips leading "/" and "./" and trailing "/" in place of a (pointer, length) pair
+static inline const char *initrd_normalize(const char *s, uint32_t *len) {
+    for (;;) {
+        if (*len >= 1 && s[0] == '/') {
+            s++;
+            (*len)--;
+        } else if (*len >= 2 && s[0] == '.' && s[1] == '/') {
+            s += 2;
+            *len -= 2;
+        } else {
+            break;
+        }
+    }
+    if (*len == 1 && s[0] == '.') *len = 0;
+    while (*len > 0 && s[*len - 1] == '/') (*len)--;
+    return s;
+}
+
+static inline int initrd_find(const char *path, uint32_t len, uint32_t hash) {
+    for (uint32_t i = 0; i < INITRD_TABLE_SIZE; i++) {
+        uint16_t slot = initrd_table[(hash + i) & (INITRD_TABLE_SIZE - 1)];
+        if (slot == 0) return -1;
+        const struct initrd_file *f = &initrd_files[slot - 1];
+        if (f->hash == hash && initrd_path_equal(f, path, len)) return slot - 1;
+    }
+    return -1;
+}
+
+// Adds an entry, copying its path into the name pool; returns its index or -1 if full
+static inline int initrd_add(const char *path, uint32_t len, uint8_t type, const uint8_t *data, uint32_t size) {
+    if (initrd_file_count >= INITRD_MAX_FILES || initrd_names_used + len + 1 > INITRD_NAME_POOL) return -1;
+
+    char *copy = initrd_names + initrd_names_used;
+    for (uint32_t i = 0; i < len; i++) copy[i] = path[i];
+    copy[len] = '\0';
+    initrd_names_used += len + 1;
+
+    int index = initrd_file_count++;
+    struct initrd_file *f = &initrd_files[index];
+    f->path = copy;
+    f->path_len = (uint16_t)len;
+    f->name = copy;
+    for (uint32_t i = 0; i < len; i++) {
+        if (copy[i] == '/') f->name = copy + i + 1;
+    }
+    f->type = type;
+    f->data = data;
+    f->size = size;
+    f->hash = initrd_hash(copy, len);
+    f->parent = INITRD_NONE;
+    f->first_child = f->last_child = f->next_sibling = INITRD_NONE;
+
+    uint32_t i = f->hash;
+    while (initrd_table[i & (INITRD_TABLE_SIZE - 1)]) i++;
+    initrd_table[i & (INITRD_TABLE_SIZE - 1)] = (uint16_t)(index + 1);
+    return index;
+}
+
+static inline uint32_t initrd_octal(const char *s, int n) {
+    uint32_t v = 0;
+    for (int i = 0; i < n && s[i] >= '0' && s[i] <= '7'; i++) v = v * 8 + (s[i] - '0');
+    return v;
+}
+
+// initrd_is_tar: true if the module starts with a ustar header
+static inline int initrd_is_tar(const uint8_t *data, uint32_t size) {
+    return size >= INITRD_BLOCK && data[257] == 'u' && data[258] == 's' && data[259] == 't' &&
+           data[260] == 'a' && data[261] == 'r';
+}
+
+// initrd_init: index a ustar archive in place; returns the entry count or -1 if it is not one
+static inline int initrd_init(const uint8_t *data, uint32_t size) {
+    if (!initrd_is_tar(data, size)) return -1;
+
+    initrd_file_count = 0;
+    initrd_names_used = 0;
+    for (int i = 0; i < INITRD_TABLE_SIZE; i++) initrd_table[i] = 0;
+    initrd_add("", 0, INITRD_DIR, NULL, 0);
+
+    char path[256];
+    uint32_t offset = 0;
+    while (offset + INITRD_BLOCK <= size) {
+        const char *h = (const char *)data + offset;
+        if (h[0] == '\0') break; // end of archive
+
+        uint32_t file_size = initrd_octal(h + 124, 12);
+        uint32_t len = 0;
+        if (h[345]) { // ustar prefix field
+            for (int i = 0; i < 155 && h[345 + i]; i++) path[len++] = h[345 + i];
+            path[len++] = '/';
+        }
+        for (int i = 0; i < 100 && h[i]; i++) path[len++] = h[i];
+
+        uint32_t norm_len = len;
+        const char *norm = initrd_normalize(path, &norm_len);
+        const uint8_t *body = data + offset + INITRD_BLOCK;
+        if (offset + INITRD_BLOCK + file_size > size) break; // truncated archive
+
+        char type = h[156];
+        if (norm_len > 0 && initrd_find(norm, norm_len, initrd_hash(norm, norm_len)) < 0) {
+            if (type == '5') {
+                initrd_add(norm, norm_len, INITRD_DIR, NULL, 0);
+            } else if (type == '0' || type == '\0') {
+                initrd_add(norm, norm_len, INITRD_FILE, body, file_size);
+            }
+        }
+        offset += INITRD_BLOCK + ((file_size + INITRD_BLOCK - 1) & ~(uint32_t)(INITRD_BLOCK - 1));
+    }
+
+    // Link every entry to its parent, creating implied directories on the way
+    for (int i = 1; i < initrd_file_count; i++) {
+        struct initrd_file *f = &initrd_files[i];
+        uint32_t parent_len = (uint32_t)(f->name - f->path);
+        if (parent_len > 0) parent_len--; // drop the "/"
+
+        int parent = initrd_find(f->path, parent_len, initrd_hash(f->path, parent_len));
+        if (parent < 0) parent = initrd_add(f->path, parent_len, INITRD_DIR, NULL, 0);
+        if (parent < 0) continue;
+
+        struct initrd_file *p = &initrd_files[parent];
+        f->parent = (uint16_t)parent;
+        if (p->last_child == INITRD_NONE) {
+            p->first_child = (uint16_t)i;
+        } else {
+            initrd_files[p->last_child].next_sibling = (uint16_t)i;
+        }
+        p->last_child = (uint16_t)i;
+    }
+    return initrd_file_count;
+}
+
+// initrd_lookup: find a file or directory by path; returns NULL if it does not exist
+static inline const struct initrd_file *initrd_lookup(const char *path) {
+    if (initrd_file_count == 0) return NULL;
+    uint32_t len = 0;
+    while (path[len]) len++;
+    path = initrd_normalize(path, &len);
+    int index = initrd_find(path, len, initrd_hash(path, len));
+    return index < 0 ? NULL : &initrd_files[index];
+}
+
+// initrd_first_child/initrd_next: iterate a directory, NULL at the end
+static inline const struct initrd_file *initrd_first_child(const struct initrd_file *dir) {
+    return dir->first_child == INITRD_NONE ? NULL : &initrd_files[dir->first_child];
+}
+
+static inline const struct initrd_file *initrd_next(const struct initrd_file *f) {
+    return f->next_sibling == INITRD_NONE ? NULL : &initrd_files[f->next_sibling];
+}
+
+#endif // MINIMAL_INITRD_H
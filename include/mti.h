@@ -0,0 +1,277 @@
+#ifndef MINIMAL_MTI_H
+#define MINIMAL_MTI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * MTI1 images: 8-bit indexed pixels, optionally with palette entries, stored
+ * RLE or LZ4-style compressed. tools/mti_pack.py writes them.
+ *
+ *   0  "MTI1"
+ *   4  width, height        uint16 LE each
+ *   8  codec                uint8, MTI_CODEC_*
+ *   9  palette_first        uint8
+ *  10  palette_count        uint16 LE, entries of 3 6-bit components follow the header
+ *  12  data_size            uint32 LE, compressed bytes after the palette
+ *
+ * RLE: control byte c < 128 copies c + 1 literals, c >= 128 repeats the next
+ * byte c - 125 times (mti_rle_encode writes it). LZ4: the LZ4 block format,
+ * except match offsets never exceed MTI_WINDOW, which is what lets the
+ * decoder stream.
+ *
+ * The decoder reads the compressed data in place and produces at most
+ * MTI_CHUNK pixels per call into a MTI_WINDOW ring. The ring is both the LZ
+ * history and the staging area mti_draw copies rows out of, so no full-size
+ * decompressed copy ever exists.
+ */
+
+#define MTI_HEADER_SIZE 16
+#define MTI_CODEC_RAW   0
+#define MTI_CODEC_RLE   1
+#define MTI_CODEC_LZ4   2
+#define MTI_WINDOW      4096 // power of two
+#define MTI_CHUNK       1024 // must not exceed MTI_WINDOW
+#define MTI_LZ4_MIN_MATCH 4
+#define MTI_SHORT_COPY  MEM_SIMD_MIN // shorter copies use a byte loop, not rep's slow startup
+
+struct mti_image {
+    uint16_t width;
+    uint16_t height;
+    uint8_t codec;
+    uint8_t palette_first;
+    uint16_t palette_count;
+    const uint8_t *palette;
+    const uint8_t *data;
+    uint32_t data_size;
+};
+
+struct mti_decoder {
+    const uint8_t *src;
+    const uint8_t *end;
+    uint32_t produced;     // pixels decoded so far
+    uint32_t total;        // width * height
+    uint32_t literal_left;
+    uint32_t run_left;     // RLE run or LZ4 match bytes still to copy
+    uint32_t match_offset; // 0 for an RLE run
+    uint8_t run_value;
+    uint8_t codec;
+    uint8_t match_nibble;  // LZ4 match length code of the current sequence
+    uint8_t match_pending; // LZ4 literals done, offset not read yet
+    uint8_t window[MTI_WINDOW];
+};
+
+static inline uint16_t mti_read16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t mti_read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// mti_parse: validate the header of an image at buf; returns 0, or -1 if it is not a usable MTI1
+static inline int mti_parse(const void *buf, uint32_t size, struct mti_image *img) {
+    const uint8_t *p = (const uint8_t *)buf;
+    if (size < MTI_HEADER_SIZE || p[0] != 'M' || p[1] != 'T' || p[2] != 'I' || p[3] != '1') return -1;
+
+    img->width = mti_read16(p + 4);
+    img->height = mti_read16(p + 6);
+    img->codec = p[8];
+    img->palette_first = p[9];
+    img->palette_count = mti_read16(p + 10);
+    img->data_size = mti_read32(p + 12);
+    img->palette = p + MTI_HEADER_SIZE;
+    img->data = img->palette + img->palette_count * 3;
+
+    if (img->codec > MTI_CODEC_LZ4 || img->palette_first + img->palette_count > 256) return -1;
+    // checked piecewise so a hostile data_size cannot wrap the sum
+    if ((uint32_t)img->palette_count * 3 > size - MTI_HEADER_SIZE) return -1;
+    if (img->data_size > size - MTI_HEADER_SIZE - (uint32_t)img->palette_count * 3) return -1;
+    return 0;
+}
+
+static inline void mti_decoder_init(struct mti_decoder *d, const struct mti_image *img) {
+    d->src = img->data;
+    d->end = img->data + img->data_size;
+    d->produced = 0;
+    d->total = (uint32_t)img->width * img->height;
+    d->literal_left = img->codec == MTI_CODEC_RAW ? d->total : 0;
+    d->run_left = 0;
+    d->match_offset = 0;
+    d->codec = img->codec;
+    d->match_pending = 0;
+}
+
+// LZ4 length extension: 255 bytes continue, anything else ends it; -1 if truncated
+static inline int mti_read_length(struct mti_decoder *d, uint32_t *len) {
+    uint8_t b;
+    do {
+        if (d->src >= d->end) return -1;
+        b = *d->src++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+// Copies n literal bytes into the ring at the current position
+static inline void mti_put_literals(struct mti_decoder *d, uint32_t n) {
+    uint32_t pos = d->produced & (MTI_WINDOW - 1);
+    if (n <= MTI_SHORT_COPY && pos + n <= MTI_WINDOW) {
+        for (uint32_t i = 0; i < n; i++) d->window[pos + i] = d->src[i];
+        d->src += n;
+        d->produced += n;
+        return;
+    }
+    uint32_t first = MTI_WINDOW - pos < n ? MTI_WINDOW - pos : n;
+    memcpy(d->window + pos, d->src, first);
+    if (n > first) memcpy(d->window, d->src + first, n - first);
+    d->src += n;
+    d->produced += n;
+}
+
+// Copies n bytes of the current run or match into the ring
+static inline void mti_put_repeat(struct mti_decoder *d, uint32_t n) {
+    uint32_t dst = d->produced & (MTI_WINDOW - 1);
+    if (d->match_offset == 0 && n <= MTI_SHORT_COPY && dst + n <= MTI_WINDOW) {
+        for (uint32_t i = 0; i < n; i++) d->window[dst + i] = d->run_value;
+    } else if (d->match_offset == 0) {
+        uint32_t first = MTI_WINDOW - dst < n ? MTI_WINDOW - dst : n;
+        memset(d->window + dst, d->run_value, first);
+        if (n > first) memset(d->window, d->run_value, n - first);
+    } else {
+        uint32_t src = (d->produced - d->match_offset) & (MTI_WINDOW - 1);
+        if (d->match_offset >= n && n > MTI_SHORT_COPY && dst + n <= MTI_WINDOW && src + n <= MTI_WINDOW) {
+            memcpy(d->window + dst, d->window + src, n);
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                d->window[(dst + i) & (MTI_WINDOW - 1)] = d->window[(src + i) & (MTI_WINDOW - 1)];
+            }
+        }
+    }
+    d->produced += n;
+}
+
+// mti_decode: decode up to max (<= MTI_CHUNK) pixels into the ring.
+// Returns the number produced, 0 once the image is complete, -1 on corrupt data.
+static inline int mti_decode(struct mti_decoder *d, uint32_t max) {
+    uint32_t start = d->produced;
+    uint32_t limit = d->total - d->produced < max ? d->total : d->produced + max;
+
+    while (d->produced < limit) {
+        uint32_t room = limit - d->produced;
+
+        if (d->literal_left) {
+            uint32_t n = d->literal_left < room ? d->literal_left : room;
+            if ((uint32_t)(d->end - d->src) < n) return -1;
+            mti_put_literals(d, n);
+            d->literal_left -= n;
+            continue;
+        }
+        if (d->run_left) {
+            uint32_t n = d->run_left < room ? d->run_left : room;
+            mti_put_repeat(d, n);
+            d->run_left -= n;
+            continue;
+        }
+        if (d->match_pending) {
+            d->match_pending = 0;
+            if (d->end - d->src < 2) return -1;
+            d->match_offset = mti_read16(d->src);
+            d->src += 2;
+            if (d->match_offset == 0 || d->match_offset > MTI_WINDOW || d->match_offset > d->produced) return -1;
+            d->run_left = d->match_nibble + MTI_LZ4_MIN_MATCH;
+            if (d->match_nibble == 15 && mti_read_length(d, &d->run_left)) return -1;
+            continue;
+        }
+        if (d->src >= d->end) return -1;
+
+        uint8_t c = *d->src++;
+        if (d->codec == MTI_CODEC_RLE) {
+            if (c < 128) {
+                d->literal_left = c + 1;
+            } else {
+                if (d->src >= d->end) return -1;
+                d->run_value = *d->src++;
+                d->match_offset = 0;
+                d->run_left = c - 125;
+            }
+        } else if (d->codec == MTI_CODEC_LZ4) {
+            d->literal_left = c >> 4;
+            if (d->literal_left == 15 && mti_read_length(d, &d->literal_left)) return -1;
+            d->match_nibble = c & 15;
+            d->match_pending = 1;
+        } else {
+            return -1;
+        }
+    }
+    return (int)(d->produced - start);
+}
+
+// Copies n ring bytes starting at stream position pos to dst
+static inline void mti_copy_out(uint8_t *dst, const struct mti_decoder *d, uint32_t pos, uint32_t n) {
+    uint32_t at = pos & (MTI_WINDOW - 1);
+    uint32_t first = MTI_WINDOW - at < n ? MTI_WINDOW - at : n;
+    memcpy(dst, d->window + at, first);
+    if (n > first) memcpy(dst + first, d->window, n - first);
+}
+
+// mti_draw: decode img with its top-left at (x, y) of a dst_w x dst_h surface, clipped.
+// Returns 0, or -1 if the data is corrupt (pixels decoded before the error stay drawn).
+static inline int mti_draw(struct mti_decoder *d, const struct mti_image *img,
+                           uint8_t *dst, int pitch, int dst_w, int dst_h, int x, int y) {
+    int n;
+    mti_decoder_init(d, img);
+    while ((n = mti_decode(d, MTI_CHUNK)) > 0) {
+        uint32_t pos = d->produced - n;
+        uint32_t end = d->produced;
+        while (pos < end) {
+            uint32_t row = pos / img->width;
+            uint32_t col = pos - row * img->width;
+            uint32_t len = img->width - col < end - pos ? img->width - col : end - pos;
+            int sy = y + (int)row;
+            int x0 = x + (int)col;
+            int x1 = x0 + (int)len;
+            if (x0 < 0) x0 = 0;
+            if (x1 > dst_w) x1 = dst_w;
+            if (sy >= 0 && sy < dst_h && x0 < x1) {
+                mti_copy_out(dst + sy * pitch + x0, d, pos + (uint32_t)(x0 - x - (int)col), x1 - x0);
+            }
+            pos += len;
+        }
+    }
+    return n < 0 || d->produced != d->total ? -1 : 0;
+}
+
+// mti_rle_encode: RLE-encode n bytes of src into dst (MTI_CODEC_RLE format).
+// Returns the encoded size, or -1 if it does not fit in cap bytes.
+static inline int mti_rle_encode(const uint8_t *src, uint32_t n, uint8_t *dst, uint32_t cap) {
+    uint32_t out = 0, i = 0, literal_start = 0;
+    while (i <= n) {
+        uint32_t run = 1;
+        if (i < n) {
+            while (i + run < n && run < 130 && src[i + run] == src[i]) run++;
+        }
+        if (i == n || run >= 3) {
+            // flush pending literals in chunks of up to 128
+            while (literal_start < i) {
+                uint32_t len = i - literal_start < 128 ? i - literal_start : 128;
+                if (out + 1 + len > cap) return -1;
+                dst[out++] = (uint8_t)(len - 1);
+                for (uint32_t k = 0; k < len; k++) dst[out++] = src[literal_start + k];
+                literal_start += len;
+            }
+            if (i == n) break;
+            if (out + 2 > cap) return -1;
+            dst[out++] = (uint8_t)(run + 125);
+            dst[out++] = src[i];
+            i += run;
+            literal_start = i;
+        } else {
+            i += run;
+        }
+    }
+    return (int)out;
+}
+
+#endif // MINIMAL_MTI_H
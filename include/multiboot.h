@@ -0,0 +1,64 @@
+#ifndef MINIMAL_MULTIBOOT_H
+#define MINIMAL_MULTIBOOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Value in EAX when a Multiboot loader jumps to _start
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+// multiboot_info.flags: which fields the loader filled in
+#define MULTIBOOT_INFO_MEMORY  (1u << 0)
+#define MULTIBOOT_INFO_CMDLINE (1u << 2)
+#define MULTIBOOT_INFO_MODS    (1u << 3)
+#define MULTIBOOT_INFO_MMAP    (1u << 6)
+
+// Boot information passed in EBX (only the fields up to the memory map)
+struct multiboot_info {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+};
+
+// One loaded module: [mod_start, mod_end) in physical memory, identity mapped here
+struct multiboot_module {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t cmdline;
+    uint32_t reserved;
+};
+
+// multiboot_modules: the module list, or NULL when the loader passed none
+static inline const struct multiboot_module *multiboot_modules(uint32_t magic, const struct multiboot_info *mbi,
+                                                               uint32_t *count) {
+    *count = 0;
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !mbi || !(mbi->flags & MULTIBOOT_INFO_MODS)) return NULL;
+    *count = mbi->mods_count;
+    return (const struct multiboot_module *)mbi->mods_addr;
+}
+
+// multiboot_cmdline_has: true if the kernel command line contains word as a space-separated token
+static inline int multiboot_cmdline_has(uint32_t magic, const struct multiboot_info *mbi, const char *word) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !mbi || !(mbi->flags & MULTIBOOT_INFO_CMDLINE)) return 0;
+    const char *p = (const char *)mbi->cmdline;
+    while (*p) {
+        while (*p == ' ') p++;
+        const char *w = word;
+        while (*w && *p == *w) {
+            p++;
+            w++;
+        }
+        if (!*w && (*p == ' ' || *p == '\0')) return 1;
+        while (*p && *p != ' ') p++;
+    }
+    return 0;
+}
+
+#endif // MINIMAL_MULTIBOOT_H
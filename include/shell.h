@@ -0,0 +1,98 @@
+#ifndef MINIMAL_SHELL_H
+#define MINIMAL_SHELL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHELL_MAX_COMMANDS 64
+#define SHELL_TABLE_SIZE   (SHELL_MAX_COMMANDS * 2) // power of two, kept half empty
+#define SHELL_MAX_ARGS     32
+
+// A registered command; handlers get the tokenized line with argv[0] = name
+struct shell_command {
+    const char *name;
+    const char *help;
+    void (*handler)(int argc, char **argv);
+    uint32_t hash;
+};
+
+// Commands in registration order, used for help listings
+static struct shell_command shell_commands[SHELL_MAX_COMMANDS];
+static int shell_command_count = 0;
+
+// Open-addressed hash table of indices into shell_commands, 0 = empty slot
+static uint8_t shell_table[SHELL_TABLE_SIZE];
+
+// shell_hash: FNV-1a over a command name
+static inline uint32_t shell_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline int shell_name_equal(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// shell_lookup: find a command by name; returns NULL if it is not registered
+static inline const struct shell_command *shell_lookup(const char *name) {
+    uint32_t hash = shell_hash(name);
+    for (uint32_t i = 0; i < SHELL_TABLE_SIZE; i++) {
+        uint8_t slot = shell_table[(hash + i) & (SHELL_TABLE_SIZE - 1)];
+        if (slot == 0) return NULL;
+        const struct shell_command *cmd = &shell_commands[slot - 1];
+        if (cmd->hash == hash && shell_name_equal(cmd->name, name)) return cmd;
+    }
+    return NULL;
+}
+
+// shell_register: add a command; returns 0 on success, -1 if full or already registered
+static inline int shell_register(const char *name, const char *help,
+                                 void (*handler)(int argc, char **argv)) {
+    if (shell_command_count >= SHELL_MAX_COMMANDS || shell_lookup(name)) return -1;
+
+    struct shell_command *cmd = &shell_commands[shell_command_count++];
+    cmd->name = name;
+    cmd->help = help;
+    cmd->handler = handler;
+    cmd->hash = shell_hash(name);
+
+    uint32_t i = cmd->hash;
+    while (shell_table[i & (SHELL_TABLE_SIZE - 1)]) i++;
+    shell_table[i & (SHELL_TABLE_SIZE - 1)] = (uint8_t)shell_command_count;
+    return 0;
+}
+
+// shell_tokenize: split line in place on spaces; returns argc, argv[argc] = NULL
+static inline int shell_tokenize(char *line, char **argv, int max_args) {
+    int argc = 0;
+    while (*line) {
+        while (*line == ' ') *line++ = '\0';
+        if (!*line) break;
+        if (argc < max_args - 1) argv[argc++] = line;
+        while (*line && *line != ' ') line++;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+// shell_parse_uint: decimal argument into *out; returns -1 unless s is all digits and fits
+static inline int shell_parse_uint(const char *s, uint32_t *out) {
+    uint32_t v = 0;
+    if (!*s) return -1;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9' || v > (0xFFFFFFFFu - (*s - '0')) / 10) return -1;
+        v = v * 10 + (*s - '0');
+    }
+    *out = v;
+    return 0;
+}
+
+#endif // MINIMAL_SHELL_H
@@ -1,6 +1,10 @@
 #ifndef MINIMAL_STRING_H
 #define MINIMAL_STRING_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <cpu.h>
+
 // strlen: get length of null-terminated string
 static inline unsigned int strlen(const char *s) {
     unsigned int len = 0;
@@ -45,4 +49,303 @@ static inline int strncmp(const char *s1, const char *s2, unsigned int n) {
     return 0;
 }
 
+// memcmp: compare n bytes; returns 0 if equal, <0 or >0 like strcmp
+static inline int memcmp(const void *a, const void *b, size_t n) {
+    const unsigned char *p = (const unsigned char *)a;
+    const unsigned char *q = (const unsigned char *)b;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] != q[i]) return p[i] - q[i];
+    }
+    return 0;
+}
+
+/*
+ * mem* family. Each has a rep movs/stos baseline that runs on any i386, plus
+ * MMX and SSE2 variants for larger blocks. mem_init() picks the best variant
+ * once at boot; memcpy/memset/memmove then call through a function pointer.
+ */
+#define MEM_SIMD_MIN     64          // below this the rep baseline is faster
+#define MEM_NONTEMPORAL  (256 * 1024) // bypass the cache for copies this large
+
+// memcpy_rep: align dest to 4, rep movsl the body, rep movsb the tail
+static inline void *memcpy_rep(void *dest, const void *src, size_t n) {
+    void *d = dest;
+    size_t head = n >= 8 ? (-(uintptr_t)dest) & 3 : 0;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+    __asm__ volatile (
+        "rep movsb\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep movsl\n\t"
+        "movl %4, %%ecx\n\t"
+        "rep movsb"
+        : "+D"(d), "+S"(src), "+c"(head)
+        : "r"(words), "r"(tail)
+        : "memory");
+    return dest;
+}
+
+// memset_rep: align dest to 4, rep stosl the body, rep stosb the tail
+static inline void *memset_rep(void *dest, int c, size_t n) {
+    void *d = dest;
+    uint32_t v = (uint8_t)c * 0x01010101u;
+    size_t head = n >= 8 ? (-(uintptr_t)dest) & 3 : 0;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+    __asm__ volatile (
+        "rep stosb\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep stosl\n\t"
+        "movl %4, %%ecx\n\t"
+        "rep stosb"
+        : "+D"(d), "+c"(head)
+        : "a"(v), "r"(words), "r"(tail)
+        : "memory");
+    return dest;
+}
+
+// memmove_back_rep: copy from the end down, for dest overlapping above src
+static inline void *memmove_back_rep(void *dest, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dest + n - 1;
+    const uint8_t *s = (const uint8_t *)src + n - 1;
+    size_t tail = n & 3;
+    size_t words = n >> 2;
+    __asm__ volatile (
+        "std\n\t"
+        "rep movsb\n\t"
+        "subl $3, %%esi\n\t"
+        "subl $3, %%edi\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep movsl\n\t"
+        "cld"
+        : "+D"(d), "+S"(s), "+c"(tail)
+        : "r"(words)
+        : "memory");
+    return dest;
+}
+
+/*
+ * The SIMD variants never go through rep for their head and tail: they load
+ * the first and last vector of the source up front, run aligned stores over
+ * the body, then store the two edge vectors unaligned (overlapping the body).
+ * Loading the edges first also keeps forward memmove correct for overlap.
+ * Each variant is one asm statement, so no vector register has to stay
+ * live between statements. They cannot be listed as clobbers either: for
+ * -march=i386 the compiler neither knows nor allocates them. The loops step
+ * an offset i from dest; stop is the last offset a 64-byte block may start at.
+ */
+static inline void *memcpy_mmx(void *dest, const void *src, size_t n) {
+    if (n < MEM_SIMD_MIN) return memcpy_rep(dest, src, n);
+    int i = (-(uintptr_t)dest) & 7;
+    int stop = (int)((((uintptr_t)dest + n) & ~(uintptr_t)7) - (uintptr_t)dest) - 64;
+    __asm__ volatile (
+        "movq (%[s]), %%mm4\n\t"
+        "movq -8(%[s],%[n]), %%mm5\n\t"
+        "jmp 2f\n"
+        "1:\n\t"
+        "movq   (%[s],%[i]), %%mm0\n\t"
+        "movq  8(%[s],%[i]), %%mm1\n\t"
+        "movq 16(%[s],%[i]), %%mm2\n\t"
+        "movq 24(%[s],%[i]), %%mm3\n\t"
+        "movq %%mm0,   (%[d],%[i])\n\t"
+        "movq %%mm1,  8(%[d],%[i])\n\t"
+        "movq %%mm2, 16(%[d],%[i])\n\t"
+        "movq %%mm3, 24(%[d],%[i])\n\t"
+        "movq 32(%[s],%[i]), %%mm0\n\t"
+        "movq 40(%[s],%[i]), %%mm1\n\t"
+        "movq 48(%[s],%[i]), %%mm2\n\t"
+        "movq 56(%[s],%[i]), %%mm3\n\t"
+        "movq %%mm0, 32(%[d],%[i])\n\t"
+        "movq %%mm1, 40(%[d],%[i])\n\t"
+        "movq %%mm2, 48(%[d],%[i])\n\t"
+        "movq %%mm3, 56(%[d],%[i])\n\t"
+        "addl $64, %[i]\n"
+        "2:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 1b\n\t"
+        "addl $56, %[stop]\n\t" // last offset for a single vector
+        "jmp 4f\n"
+        "3:\n\t"
+        "movq (%[s],%[i]), %%mm0\n\t"
+        "movq %%mm0, (%[d],%[i])\n\t"
+        "addl $8, %[i]\n"
+        "4:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 3b\n\t"
+        "movq %%mm4, (%[d])\n\t"
+        "movq %%mm5, -8(%[d],%[n])\n\t"
+        "emms"
+        : [i] "+r"(i), [stop] "+r"(stop)
+        : [s] "r"(src), [d] "r"(dest), [n] "r"(n)
+        : "memory", "cc");
+    return dest;
+}
+
+static inline void *memset_mmx(void *dest, int c, size_t n) {
+    if (n < MEM_SIMD_MIN) return memset_rep(dest, c, n);
+    uint32_t v = (uint8_t)c * 0x01010101u;
+    int i = (-(uintptr_t)dest) & 7;
+    int stop = (int)((((uintptr_t)dest + n) & ~(uintptr_t)7) - (uintptr_t)dest) - 64;
+    __asm__ volatile (
+        "movd %[v], %%mm0\n\t"
+        "punpckldq %%mm0, %%mm0\n\t"
+        "movq %%mm0, (%[d])\n\t"
+        "movq %%mm0, -8(%[d],%[n])\n\t"
+        "jmp 2f\n"
+        "1:\n\t"
+        "movq %%mm0,   (%[d],%[i])\n\t"
+        "movq %%mm0,  8(%[d],%[i])\n\t"
+        "movq %%mm0, 16(%[d],%[i])\n\t"
+        "movq %%mm0, 24(%[d],%[i])\n\t"
+        "movq %%mm0, 32(%[d],%[i])\n\t"
+        "movq %%mm0, 40(%[d],%[i])\n\t"
+        "movq %%mm0, 48(%[d],%[i])\n\t"
+        "movq %%mm0, 56(%[d],%[i])\n\t"
+        "addl $64, %[i]\n"
+        "2:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 1b\n\t"
+        "addl $56, %[stop]\n\t"
+        "jmp 4f\n"
+        "3:\n\t"
+        "movq %%mm0, (%[d],%[i])\n\t"
+        "addl $8, %[i]\n"
+        "4:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 3b\n\t"
+        "emms"
+        : [i] "+r"(i), [stop] "+r"(stop)
+        : [v] "rm"(v), [d] "r"(dest), [n] "r"(n)
+        : "memory", "cc");
+    return dest;
+}
+
+static inline void *memcpy_sse2(void *dest, const void *src, size_t n) {
+    if (n < MEM_SIMD_MIN) return memcpy_rep(dest, src, n);
+    int i = (-(uintptr_t)dest) & 15;
+    int stop = (int)((((uintptr_t)dest + n) & ~(uintptr_t)15) - (uintptr_t)dest) - 64;
+    __asm__ volatile (
+        "movdqu (%[s]), %%xmm4\n\t"
+        "movdqu -16(%[s],%[n]), %%xmm5\n\t"
+        "cmpl %[nt], %[n]\n\t"
+        "jb 2f\n\t"
+        "jmp 6f\n"
+        "5:\n\t"
+        "movdqu   (%[s],%[i]), %%xmm0\n\t"
+        "movdqu 16(%[s],%[i]), %%xmm1\n\t"
+        "movdqu 32(%[s],%[i]), %%xmm2\n\t"
+        "movdqu 48(%[s],%[i]), %%xmm3\n\t"
+        "movntdq %%xmm0,   (%[d],%[i])\n\t"
+        "movntdq %%xmm1, 16(%[d],%[i])\n\t"
+        "movntdq %%xmm2, 32(%[d],%[i])\n\t"
+        "movntdq %%xmm3, 48(%[d],%[i])\n\t"
+        "addl $64, %[i]\n"
+        "6:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 5b\n\t"
+        "sfence\n\t"
+        "jmp 2f\n"
+        "1:\n\t"
+        "movdqu   (%[s],%[i]), %%xmm0\n\t"
+        "movdqu 16(%[s],%[i]), %%xmm1\n\t"
+        "movdqu 32(%[s],%[i]), %%xmm2\n\t"
+        "movdqu 48(%[s],%[i]), %%xmm3\n\t"
+        "movdqa %%xmm0,   (%[d],%[i])\n\t"
+        "movdqa %%xmm1, 16(%[d],%[i])\n\t"
+        "movdqa %%xmm2, 32(%[d],%[i])\n\t"
+        "movdqa %%xmm3, 48(%[d],%[i])\n\t"
+        "addl $64, %[i]\n"
+        "2:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 1b\n\t"
+        "addl $48, %[stop]\n\t" // last offset for a single vector
+        "jmp 4f\n"
+        "3:\n\t"
+        "movdqu (%[s],%[i]), %%xmm0\n\t"
+        "movdqa %%xmm0, (%[d],%[i])\n\t"
+        "addl $16, %[i]\n"
+        "4:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 3b\n\t"
+        "movdqu %%xmm4, (%[d])\n\t"
+        "movdqu %%xmm5, -16(%[d],%[n])"
+        : [i] "+r"(i), [stop] "+r"(stop)
+        : [s] "r"(src), [d] "r"(dest), [n] "r"(n), [nt] "i"(MEM_NONTEMPORAL)
+        : "memory", "cc");
+    return dest;
+}
+
+static inline void *memset_sse2(void *dest, int c, size_t n) {
+    if (n < MEM_SIMD_MIN) return memset_rep(dest, c, n);
+    uint32_t v = (uint8_t)c * 0x01010101u;
+    int i = (-(uintptr_t)dest) & 15;
+    int stop = (int)((((uintptr_t)dest + n) & ~(uintptr_t)15) - (uintptr_t)dest) - 64;
+    __asm__ volatile (
+        "movd %[v], %%xmm0\n\t"
+        "pshufd $0, %%xmm0, %%xmm0\n\t"
+        "movdqu %%xmm0, (%[d])\n\t"
+        "movdqu %%xmm0, -16(%[d],%[n])\n\t"
+        "jmp 2f\n"
+        "1:\n\t"
+        "movdqa %%xmm0,   (%[d],%[i])\n\t"
+        "movdqa %%xmm0, 16(%[d],%[i])\n\t"
+        "movdqa %%xmm0, 32(%[d],%[i])\n\t"
+        "movdqa %%xmm0, 48(%[d],%[i])\n\t"
+        "addl $64, %[i]\n"
+        "2:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 1b\n\t"
+        "addl $48, %[stop]\n\t"
+        "jmp 4f\n"
+        "3:\n\t"
+        "movdqa %%xmm0, (%[d],%[i])\n\t"
+        "addl $16, %[i]\n"
+        "4:\n\t"
+        "cmpl %[stop], %[i]\n\t"
+        "jle 3b"
+        : [i] "+r"(i), [stop] "+r"(stop)
+        : [v] "rm"(v), [d] "r"(dest), [n] "r"(n)
+        : "memory", "cc");
+    return dest;
+}
+
+static void *(*memcpy_impl)(void *, const void *, size_t) = memcpy_rep;
+static void *(*memset_impl)(void *, int, size_t) = memset_rep;
+static const char *mem_impl_name = "rep";
+
+// mem_init: select the mem* variants for this CPU; call once at boot
+static inline void mem_init(void) {
+    if (cpu_can_use_sse2()) {
+        memcpy_impl = memcpy_sse2;
+        memset_impl = memset_sse2;
+        mem_impl_name = "SSE2";
+    } else if (cpu_can_use_mmx()) {
+        memcpy_impl = memcpy_mmx;
+        memset_impl = memset_mmx;
+        mem_impl_name = "MMX";
+    } else {
+        memcpy_impl = memcpy_rep;
+        memset_impl = memset_rep;
+        mem_impl_name = "rep";
+    }
+}
+
+// memcpy: copy n bytes from src to dest; the regions must not overlap
+static inline void *memcpy(void *dest, const void *src, size_t n) {
+    return memcpy_impl(dest, src, n);
+}
+
+// memset: fill n bytes of dest with the byte c
+static inline void *memset(void *dest, int c, size_t n) {
+    return memset_impl(dest, c, n);
+}
+
+// memmove: copy n bytes from src to dest; the regions may overlap
+static inline void *memmove(void *dest, const void *src, size_t n) {
+    // Forward copies are safe whenever dest starts below src
+    if ((uintptr_t)dest <= (uintptr_t)src || (uintptr_t)dest >= (uintptr_t)src + n)
+        return memcpy_impl(dest, src, n);
+    return memmove_back_rep(dest, src, n);
+}
+
 #endif // MINIMAL_STRING_H
@@ -1,5 +1,11 @@
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+#include <cpu.h>
+#include <multiboot.h>
+#include <mti.h>
+#include <fixed.h>
+#include <shell.h>
 #include <font8x8_basic.h>
 
 #define VGA_MODE13_WIDTH  320
@@ -14,48 +20,16 @@
 #define PIT_COMMAND_PORT 0x43
 #define PIT_FREQUENCY 1193182UL
 #define ABS(x) ((x) < 0 ? -(x) : (x))
+#define PULSE_COLOR 0xF0 // DAC entry animated by the pulsing box
 
 char input_buffer[4096];
 int input_len = 0;
 
-void handle_command(const char* cmd);
-
-int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
-    }
-    return (unsigned char)(*s1) - (unsigned char)(*s2);
-}
-
-int strncmp(const char* s1, const char* s2, int n) {
-    for (int i = 0; i < n; i++) {
-        if (s1[i] != s2[i] || s1[i] == '\0' || s2[i] == '\0')
-            return (unsigned char)s1[i] - (unsigned char)s2[i];
-    }
-    return 0;
-}
-char* strcpy(char* dest, const char* src) {
-    char* orig = dest;
-    while ((*dest++ = *src++));
-    return orig;
-}
-
-char* strncpy(char* dest, const char* src, int n) {
-    char* orig = dest;
-    int i = 0;
-    while (i < n && src[i]) {
-        dest[i] = src[i];
-        i++;
-    }
-    while (i < n) {
-        dest[i++] = '\0';
-    }
-    return orig;
-}
+void handle_command(char* cmd);
 
 unsigned long long __udivdi3(unsigned long long dividend, unsigned long long divisor) {
     if (divisor == 0) return 0xFFFFFFFFFFFFFFFFULL;
+    if (!(dividend >> 32) && !(divisor >> 32)) return (uint32_t)dividend / (uint32_t)divisor;
 
     unsigned long long quotient = 0;
     unsigned long long remainder = 0;
@@ -72,6 +46,13 @@ unsigned long long __udivdi3(unsigned long long dividend, unsigned long long div
     return quotient;
 }
 
+long long __divdi3(long long dividend, long long divisor) {
+    int negative = (dividend < 0) != (divisor < 0);
+    unsigned long long q = __udivdi3(dividend < 0 ? -(unsigned long long)dividend : (unsigned long long)dividend,
+                                     divisor < 0 ? -(unsigned long long)divisor : (unsigned long long)divisor);
+    return negative ? -(long long)q : (long long)q;
+}
+
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
 }
@@ -92,6 +73,16 @@ static inline void outw(uint16_t port, uint16_t val) {
     __asm__ volatile ("outw %0, %1" : : "a"(val), "Nd"(port));
 }
 
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    __asm__ volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
 static inline uint64_t rdtsc() {
     uint32_t lo, hi;
     __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
@@ -119,12 +110,28 @@ void pit_wait_count(uint16_t target_count) {
     while (pit_read_counter() > target_count);
 }
 
-uint64_t measure_cpu_frequency() {
-    pit_write(0xFFFF);
+/* Starts a TSC calibration window on PIT channel 0 (mode 0, one shot).
+ * Anything can run until pit_calibration_end as long as it takes less than
+ * one PIT period (~55 ms); a longer overlap is detected and redone. */
+#define PIT_CALIBRATION_MAX_TSC 400000000ULL // 100 ms at 4 GHz, in case the PIT never counts
 
-    uint64_t start = rdtsc();
+static uint64_t calibration_start_tsc;
+
+void pit_calibration_begin() {
+    outb(PIT_COMMAND_PORT, 0x30);
+    outb(PIT_CHANNEL0_DATA_PORT, 0xFF);
+    outb(PIT_CHANNEL0_DATA_PORT, 0xFF);
+    calibration_start_tsc = rdtsc();
+}
 
-    pit_wait_count(0xF000);
+/* Waits for the window to close and returns TSC ticks per second */
+uint64_t pit_calibration_end() {
+    outb(PIT_COMMAND_PORT, 0xE2); // read back channel 0 status
+    if (inb(PIT_CHANNEL0_DATA_PORT) & 0x80) { // OUT high: the count wrapped
+        pit_calibration_begin();
+    }
+
+    while (pit_read_counter() > 0xF000 && rdtsc() - calibration_start_tsc < PIT_CALIBRATION_MAX_TSC);
 
     uint64_t end = rdtsc();
 
@@ -134,13 +141,33 @@ uint64_t measure_cpu_frequency() {
 
     if (time_us == 0) return 0;
 
-    uint64_t cpu_freq = ((end - start) * 1000000ULL) / time_us;
+    uint64_t cpu_freq = ((end - calibration_start_tsc) * 1000000ULL) / time_us;
 
     return cpu_freq;
 }
 
+uint64_t measure_cpu_frequency() {
+    pit_calibration_begin();
+    return pit_calibration_end();
+}
+
+/* --- Deadlines ---
+ * Device waits are bounded by TSC deadlines. Until calibration finishes,
+ * tsc_per_ms assumes a fast CPU, which only makes early timeouts longer.
+ */
+#define TSC_PER_MS_GUESS 4000000ULL // 4 GHz
+
+static uint64_t tsc_per_ms = TSC_PER_MS_GUESS;
+
+static inline uint64_t deadline_after_ms(uint32_t ms) {
+    return rdtsc() + tsc_per_ms * ms;
+}
+
+static inline int deadline_passed(uint64_t deadline) {
+    return rdtsc() >= deadline;
+}
+
 void set_vga_mode_13() {
-    asm volatile ("cli");
     outb(0x3C2, 0x63);
 
     outb(0x3C4, 0x00); outb(0x3C5, 0x03);
@@ -182,10 +209,123 @@ void set_vga_mode_13() {
     outb(0x3C0, 0x20);
 }
 
+/* --- Palette ---
+ * palette_base holds the colors set through the API; palette_shadow holds
+ * what the DAC should show once fades are applied. Changes only touch the
+ * shadow and widen a dirty range; palette_flush uploads that range in one
+ * rep outsb burst at the start of vertical blank. Animating colors this
+ * way costs O(entries changed), whatever the number of pixels using them.
+ * Components are 6-bit DAC values (0-63). palette_generation counts changes
+ * to the base palette, for tables derived from it; entries marked volatile
+ * (animated ones) are never picked as a nearest color.
+ */
+#define DAC_READ_INDEX   0x3C7
+#define DAC_WRITE_INDEX  0x3C8
+#define DAC_DATA         0x3C9
+#define VGA_INPUT_STATUS 0x3DA
+#define VGA_VRETRACE     0x08
+#define VBLANK_TIMEOUT_MS 50
+
+static uint8_t palette_base[256][3];
+static uint8_t palette_shadow[256][3];
+static int palette_dirty_first = 256;
+static int palette_dirty_last = -1;
+static uint32_t palette_generation = 0;
+static uint8_t palette_volatile[256];
+
+static void palette_mark_dirty(int first, int count) {
+    if (first < palette_dirty_first) palette_dirty_first = first;
+    if (first + count - 1 > palette_dirty_last) palette_dirty_last = first + count - 1;
+}
+
+/* Reads the DAC as the BIOS left it */
+void palette_init() {
+    outb(DAC_READ_INDEX, 0);
+    uint8_t* p = &palette_base[0][0];
+    for (int i = 0; i < 256 * 3; i++) {
+        p[i] = inb(DAC_DATA) & 0x3F;
+    }
+    memcpy(palette_shadow, palette_base, sizeof(palette_shadow));
+    palette_generation++;
+}
+
+void palette_set_range(int first, int count, const uint8_t* rgb) {
+    if (first < 0 || count <= 0 || first + count > 256) return;
+    memcpy(palette_base[first], rgb, count * 3);
+    memcpy(palette_shadow[first], rgb, count * 3);
+    palette_mark_dirty(first, count);
+    palette_generation++;
+}
+
+void palette_set(int index, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t rgb[3] = { r, g, b };
+    palette_set_range(index, 1, rgb);
+}
+
+/* Rotates entries first..first+count-1 by step places toward higher indexes */
+void palette_cycle(int first, int count, int step) {
+    static uint8_t tmp[256][3];
+    if (first < 0 || count <= 1 || first + count > 256) return;
+    step %= count;
+    if (step < 0) step += count;
+    if (step == 0) return;
+
+    memcpy(tmp, palette_base[first], count * 3);
+    memcpy(palette_base[first + step], tmp[0], (count - step) * 3);
+    memcpy(palette_base[first], tmp[count - step], step * 3);
+    memcpy(tmp, palette_shadow[first], count * 3);
+    memcpy(palette_shadow[first + step], tmp[0], (count - step) * 3);
+    memcpy(palette_shadow[first], tmp[count - step], step * 3);
+    palette_mark_dirty(first, count);
+    palette_generation++;
+}
+
+/* Keeps an entry that will be animated out of nearest-color searches */
+void palette_set_volatile(int index, int on) {
+    if (index < 0 || index > 255) return;
+    palette_volatile[index] = on != 0;
+    palette_generation++;
+}
+
+/* Scales entries first..first+count-1 of the base palette by level/256 */
+void palette_fade(int first, int count, int level) {
+    if (first < 0 || count <= 0 || first + count > 256) return;
+    if (level < 0) level = 0;
+    if (level > 256) level = 256;
+    for (int i = first; i < first + count; i++) {
+        palette_shadow[i][0] = (palette_base[i][0] * level) >> 8;
+        palette_shadow[i][1] = (palette_base[i][1] * level) >> 8;
+        palette_shadow[i][2] = (palette_base[i][2] * level) >> 8;
+    }
+    palette_mark_dirty(first, count);
+}
+
+/* Waits for the start of the next vertical retrace (bounded if it never comes) */
+void vga_wait_vblank() {
+    uint64_t deadline = deadline_after_ms(VBLANK_TIMEOUT_MS);
+    while ((inb(VGA_INPUT_STATUS) & VGA_VRETRACE) && !deadline_passed(deadline));
+    while (!(inb(VGA_INPUT_STATUS) & VGA_VRETRACE) && !deadline_passed(deadline));
+}
+
+/* Uploads the dirty range, if any, in one burst during vertical blank; returns 1 if it waited for the retrace */
+int palette_flush() {
+    if (palette_dirty_last < palette_dirty_first) return 0;
+
+    const uint8_t* src = palette_shadow[palette_dirty_first];
+    uint32_t bytes = (palette_dirty_last - palette_dirty_first + 1) * 3;
+    vga_wait_vblank();
+    outb(DAC_WRITE_INDEX, palette_dirty_first);
+    __asm__ volatile ("rep outsb" : "+S"(src), "+c"(bytes) : "d"((uint16_t)DAC_DATA) : "memory");
+
+    palette_dirty_first = 256;
+    palette_dirty_last = -1;
+    return 1;
+}
+
 void serial_init() {
     outb(COM1_PORT + 1, 0x00);
     outb(COM1_PORT + 3, 0x80);
-    outb(COM1_PORT + 0, 0x03);
+    outb(COM1_PORT + 0, 0x01); // divisor 1: 115200 baud
     outb(COM1_PORT + 1, 0x00);
     outb(COM1_PORT + 3, 0x03);
     outb(COM1_PORT + 2, 0xC7);
@@ -196,9 +336,18 @@ int serial_is_transmit_ready() {
     return inb(COM1_PORT + 5) & 0x20;
 }
 
+// Set while a terminal command runs, so its output shows on screen too
+static void (*serial_echo)(char c) = NULL;
+
 void serial_write_char(char c) {
     while (!serial_is_transmit_ready());
     outb(COM1_PORT, c);
+    if (serial_echo) serial_echo(c);
+}
+
+void serial_write(const void* data, uint32_t n) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (n--) serial_write_char(*p++);
 }
 
 void serial_print(const char* str) {
@@ -208,6 +357,331 @@ void serial_print(const char* str) {
     }
 }
 
+void serial_print_dec(uint64_t value) {
+    char buf[21];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        uint64_t q = value / 10;
+        buf[--i] = '0' + (char)(value - q * 10);
+        value = q;
+    } while (value);
+    serial_print(&buf[i]);
+}
+
+/* Prints value / 100 with two decimals */
+void serial_print_centi(uint64_t value) {
+    uint64_t whole = value / 100;
+    uint32_t frac = (uint32_t)(value - whole * 100);
+    serial_print_dec(whole);
+    serial_write_char('.');
+    serial_write_char('0' + frac / 10);
+    serial_write_char('0' + frac % 10);
+}
+
+void serial_print_hex(uint32_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    serial_print("0x");
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        serial_write_char(digits[(value >> shift) & 0xF]);
+    }
+}
+
+/* --- Interrupts ---
+ * boot.s has entry stubs for the 32 CPU exceptions and the 16 PIC IRQs
+ * (remapped to vectors 32-47). Every stub ends up in isr_dispatch with the
+ * frame below. IRQ lines stay masked until a driver calls irq_install.
+ */
+#define IDT_ENTRIES   256
+#define IRQ_BASE      32
+#define PIC1_COMMAND  0x20
+#define PIC1_DATA     0x21
+#define PIC2_COMMAND  0xA0
+#define PIC2_DATA     0xA1
+#define PIC_EOI       0x20
+
+struct interrupt_frame {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax; // pushal
+    uint32_t vector, error;
+    uint32_t eip, cs, eflags;                        // pushed by the CPU
+};
+
+struct idt_entry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed));
+
+struct idt_pointer {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+extern const uint32_t isr_stub_table[48];
+static struct idt_entry idt[IDT_ENTRIES];
+static void (*irq_handlers[16])(struct interrupt_frame* frame);
+static uint16_t irq_fpu_users = 0; // IRQs whose handlers get their own FPU context
+static uint16_t irq_mask = 0xFFFB; // everything but the cascade line
+static uint64_t irq_cycles[16];    // per IRQ, from isr_common's entry stamp through the EOI
+extern volatile uint64_t isr_entry_tsc; // stamped by isr_common in boot.s
+
+void idt_set_gate(int vector, uint32_t handler) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = 0x08;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = 0x8E; // present, ring 0, 32-bit interrupt gate
+    idt[vector].offset_high = handler >> 16;
+}
+
+void pic_remap() {
+    outb(PIC1_COMMAND, 0x11);
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, IRQ_BASE);
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, irq_mask & 0xFF);
+    outb(PIC2_DATA, irq_mask >> 8);
+}
+
+void idt_init() {
+    for (int i = 0; i < 48; i++) {
+        idt_set_gate(i, isr_stub_table[i]);
+    }
+    pic_remap();
+
+    struct idt_pointer ptr = { sizeof(idt) - 1, (uint32_t)idt };
+    __asm__ volatile ("lidt %0" : : "m"(ptr));
+}
+
+/* Holds off interrupts; hand the result back to irq_restore */
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    __asm__ volatile ("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+void irq_install(int irq, void (*handler)(struct interrupt_frame* frame)) {
+    irq_handlers[irq] = handler;
+    irq_mask &= ~(1u << irq);
+    if (irq < 8) outb(PIC1_DATA, irq_mask & 0xFF);
+    else outb(PIC2_DATA, irq_mask >> 8);
+}
+
+/* For handlers that use the FPU, MMX or SSE, including memcpy/memset of MEM_SIMD_MIN bytes or more */
+void irq_install_fpu(int irq, void (*handler)(struct interrupt_frame* frame)) {
+    irq_fpu_users |= 1u << irq;
+    irq_install(irq, handler);
+}
+
+/* --- FPU ---
+ * boot.s enables the x87 and SSE. FPU/SIMD registers are switched lazily
+ * between two contexts, the main loop and IRQ handlers: entering a context
+ * that does not own the registers sets CR0.TS, and only the first FPU, MMX
+ * or SSE instruction after that (#NM) saves the owner's state and loads the
+ * new one. Only handlers installed with irq_install_fpu enter the IRQ
+ * context; every other IRQ runs without touching CR0 and must not use
+ * those registers.
+ */
+struct fpu_state {
+    uint8_t area[512]; // FXSAVE image, or the first 108 bytes for FSAVE
+    int used;
+} __attribute__((aligned(16)));
+
+extern uint32_t fpu_present;
+extern uint32_t sse_enabled;
+
+static struct fpu_state fpu_main_state;
+static struct fpu_state fpu_irq_state;
+static struct fpu_state* fpu_current = &fpu_main_state; // context now running
+static struct fpu_state* fpu_owner = &fpu_main_state;   // context whose state is loaded
+static int fpu_ts_set = 0;
+static uint32_t fpu_switches = 0;
+
+static inline void fpu_set_ts(int set) {
+    if (set == fpu_ts_set) return;
+    fpu_ts_set = set;
+    if (set) write_cr0(read_cr0() | CR0_TS);
+    else __asm__ volatile ("clts");
+}
+
+/* Makes state the running context; TS traps its first FPU use if needed */
+static inline struct fpu_state* fpu_enter(struct fpu_state* state) {
+    struct fpu_state* prev = fpu_current;
+    fpu_current = state;
+    fpu_set_ts(fpu_owner != state);
+    return prev;
+}
+
+void fpu_handle_nm() {
+    fpu_set_ts(0);
+    if (fpu_owner == fpu_current) return;
+
+    if (sse_enabled) {
+        __asm__ volatile ("fxsave %0" : "=m"(fpu_owner->area));
+        if (fpu_current->used) __asm__ volatile ("fxrstor %0" : : "m"(fpu_current->area));
+        else __asm__ volatile ("fninit");
+    } else {
+        __asm__ volatile ("fnsave %0" : "=m"(fpu_owner->area));
+        if (fpu_current->used) __asm__ volatile ("frstor %0" : : "m"(fpu_current->area));
+        else __asm__ volatile ("fninit");
+    }
+    fpu_owner->used = 1;
+    fpu_current->used = 1;
+    fpu_owner = fpu_current;
+    fpu_switches++;
+}
+
+static const char* const exception_names[32] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range",
+    "invalid opcode", "device not available", "double fault", "coprocessor overrun",
+    "invalid TSS", "segment not present", "stack fault", "general protection",
+    "page fault", "reserved", "x87 floating point", "alignment check",
+    "machine check", "SIMD floating point", "virtualization", "control protection",
+    "reserved", "reserved", "reserved", "reserved", "reserved", "reserved",
+    "reserved", "reserved", "security", "reserved",
+};
+
+void isr_dispatch(struct interrupt_frame* frame) {
+    if (frame->vector == 7 && fpu_present) {
+        fpu_handle_nm();
+        return;
+    }
+
+    if (frame->vector < IRQ_BASE) {
+        serial_print("EXCEPTION: ");
+        serial_print(exception_names[frame->vector]);
+        serial_print(" at EIP ");
+        serial_print_hex(frame->eip);
+        serial_print(", error ");
+        serial_print_hex(frame->error);
+        serial_print("\nHalted.\n");
+        while (1) __asm__ volatile ("cli; hlt");
+    }
+
+    int irq = frame->vector - IRQ_BASE;
+    if (irq_fpu_users & (1u << irq)) {
+        struct fpu_state* prev = fpu_enter(&fpu_irq_state);
+        irq_handlers[irq](frame);
+        fpu_enter(prev);
+    } else if (irq_handlers[irq]) {
+        irq_handlers[irq](frame);
+    }
+
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+    irq_cycles[irq] += rdtsc() - isr_entry_tsc;
+}
+
+/* --- Sampling profiler ---
+ * PIT channel 0 interrupts PROFILE_HZ times a second. Each tick records the
+ * interrupted EIP plus up to PROFILE_DEPTH return addresses found by walking
+ * saved EBPs (the kernel keeps frame pointers), and counts it in a hash table
+ * keyed by the whole stack, so memory stays fixed however long it runs.
+ * Stacks that find no free slot within PROFILE_PROBES are counted as
+ * dropped. "profile" on the serial console dumps the table for
+ * tools/profile.py; "profile reset" clears it. The overhead it reports is
+ * all of IRQ 0 from isr_common's entry stamp through the EOI, so only the
+ * CPU's own delivery and the popal/iret are left out.
+ */
+#define PROFILE_HZ     1000
+#define PROFILE_DEPTH  8
+#define PROFILE_SLOTS  1024 // power of two
+#define PROFILE_PROBES 16
+
+struct profile_entry {
+    uint32_t pcs[PROFILE_DEPTH + 1]; // EIP, then callers; 0 ends a short stack
+    uint32_t count;
+};
+
+extern uint8_t stack_bottom[];
+extern uint8_t stack_top[];
+
+static struct profile_entry profile_table[PROFILE_SLOTS];
+static uint32_t profile_samples = 0;
+static uint32_t profile_dropped = 0;
+static uint64_t profile_started = 0;  // TSC at the last reset
+
+void profile_tick(struct interrupt_frame* frame) {
+    uint32_t pcs[PROFILE_DEPTH + 1];
+    int depth = 0;
+
+    pcs[depth++] = frame->eip;
+    uint32_t fp = frame->ebp;
+    while (depth <= PROFILE_DEPTH && !(fp & 3) &&
+           fp >= (uint32_t)stack_bottom && fp + 8 <= (uint32_t)stack_top) {
+        const uint32_t* f = (const uint32_t*)fp;
+        pcs[depth++] = f[1];
+        if (f[0] <= fp) break; // frames only go up the stack
+        fp = f[0];
+    }
+    for (int i = depth; i <= PROFILE_DEPTH; i++) pcs[i] = 0;
+
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < depth; i++) h = (h ^ pcs[i]) * 16777619u;
+
+    profile_samples++;
+    for (int probe = 0; probe < PROFILE_PROBES; probe++) {
+        struct profile_entry* e = &profile_table[(h + probe) & (PROFILE_SLOTS - 1)];
+        if (e->count == 0) {
+            memcpy(e->pcs, pcs, sizeof(pcs)); // under MEM_SIMD_MIN, so this IRQ stays off the FPU
+        } else if (memcmp(e->pcs, pcs, sizeof(pcs)) != 0) {
+            continue;
+        }
+        e->count++;
+        return;
+    }
+    profile_dropped++;
+}
+
+void profile_reset() {
+    uint32_t flags = irq_save(); // IRQ 0 writes all of these
+    memset(profile_table, 0, sizeof(profile_table));
+    profile_samples = profile_dropped = 0;
+    irq_cycles[0] = 0;
+    profile_started = rdtsc();
+    irq_restore(flags);
+}
+
+/* Programs PIT channel 0 as a PROFILE_HZ rate generator and starts sampling */
+void profile_init() {
+    profile_reset();
+    pit_write(PIT_FREQUENCY / PROFILE_HZ);
+    irq_install(0, profile_tick);
+}
+
+void profile_dump() {
+    uint64_t elapsed = rdtsc() - profile_started;
+    serial_print("PROFILE samples ");
+    serial_print_dec(profile_samples);
+    serial_print(" dropped ");
+    serial_print_dec(profile_dropped);
+    serial_print(" hz ");
+    serial_print_dec(PROFILE_HZ);
+    serial_print(" overhead ");
+    serial_print_centi(irq_cycles[0] * 10000 / (elapsed + 1));
+    serial_print("%\n");
+    for (int i = 0; i < PROFILE_SLOTS; i++) {
+        const struct profile_entry* e = &profile_table[i];
+        if (!e->count) continue;
+        serial_print_dec(e->count);
+        for (int d = 0; d <= PROFILE_DEPTH && e->pcs[d]; d++) {
+            serial_print(" ");
+            serial_print_hex(e->pcs[d]);
+        }
+        serial_print("\n");
+    }
+    serial_print("PROFILE END\n");
+}
+
 static int shift_pressed = 0;
 
 char scancode_to_char(uint8_t sc, int shift) {
@@ -230,340 +704,3398 @@ char scancode_to_char(uint8_t sc, int shift) {
     return 0;
 }
 
-char keyboard_poll() {
-    uint8_t status = inb(PS2_STATUS);
-    if ((status & 0x01) && !(status & 0x20)) {
-        uint8_t sc = inb(PS2_DATA);
+#define KEY_F1 '\x01'
 
-        if (sc == 0x2A || sc == 0x36) {
-            shift_pressed = 1;
-            return 0;
-        } else if (sc == 0xAA || sc == 0xB6) {
-            shift_pressed = 0;
-            return 0;
-        }
+/* Tracks shift and translates one scancode; returns 0 for releases and modifiers */
+char keyboard_scancode(uint8_t sc) {
+    if (sc == 0x3B) return KEY_F1;
+    if (sc == 0x2A || sc == 0x36) {
+        shift_pressed = 1;
+        return 0;
+    } else if (sc == 0xAA || sc == 0xB6) {
+        shift_pressed = 0;
+        return 0;
+    }
 
-        if (sc & 0x80) return 0;
+    if (sc & 0x80) return 0;
 
-        return scancode_to_char(sc, shift_pressed);
-    }
-    return 0;
+    return scancode_to_char(sc, shift_pressed);
 }
 
-void mouse_wait() {
-    while (inb(PS2_STATUS) & 0x02);
+#define MOUSE_TIMEOUT_MS 50
+#define MOUSE_ACK        0xFA
+
+/* Waits until the controller accepts a byte; returns -1 on timeout */
+int mouse_wait() {
+    uint64_t deadline = deadline_after_ms(MOUSE_TIMEOUT_MS);
+    while (inb(PS2_STATUS) & 0x02) {
+        if (deadline_passed(deadline)) return -1;
+    }
+    return 0;
 }
 
-void mouse_write(uint8_t val) {
-    mouse_wait();
+int mouse_write(uint8_t val) {
+    if (mouse_wait()) return -1;
     outb(PS2_STATUS, 0xD4);
-    mouse_wait();
+    if (mouse_wait()) return -1;
     outb(PS2_DATA, val);
+    return 0;
 }
 
-uint8_t mouse_read() {
-    while (!(inb(PS2_STATUS) & 0x01));
-    return inb(PS2_DATA);
+/* Returns the next byte from the mouse, or -1 if none arrives within ms.
+ * Keyboard bytes queued in front of it are dropped. */
+int mouse_read(uint32_t ms) {
+    uint64_t deadline = deadline_after_ms(ms);
+    for (;;) {
+        uint8_t status = inb(PS2_STATUS);
+        if ((status & 0x21) == 0x21) return inb(PS2_DATA);
+        if (status & 0x01) inb(PS2_DATA);
+        if (deadline_passed(deadline)) return -1;
+    }
 }
 
-void mouse_init() {
-    mouse_write(0xF4);
-    mouse_read();
+/* Sends a command and waits for its ACK; returns 0 on success */
+int mouse_command(uint8_t val) {
+    if (mouse_write(val)) return -1;
+    return mouse_read(MOUSE_TIMEOUT_MS) == MOUSE_ACK ? 0 : -1;
 }
 
-extern const uint8_t font8x8_basic[128][8];
-
-void put_pixel(int x, int y, uint8_t color) {
-    if (x < 0 || x >= VGA_MODE13_WIDTH || y < 0 || y >= VGA_MODE13_HEIGHT) return;
-    uint8_t* vga = (uint8_t*)VGA_MODE13_ADDR;
-    vga[y * VGA_MODE13_WIDTH + x] = color;
+/* Valid rates are 10, 20, 40, 60, 80, 100 and 200 reports per second */
+int mouse_set_sample_rate(uint8_t rate) {
+    if (mouse_command(0xF3)) return -1;
+    return mouse_command(rate);
 }
 
-void fill_screen(uint8_t color) {
-    uint8_t* vga = (uint8_t*)VGA_MODE13_ADDR;
-    for (int i = 0; i < VGA_MODE13_WIDTH * VGA_MODE13_HEIGHT; i++) {
-        vga[i] = color;
-    }
+/* IntelliMouse knock: rates 200, 100, 80, then ID 3 means a 4-byte packet with a wheel */
+int mouse_enable_wheel() {
+    if (mouse_set_sample_rate(200) || mouse_set_sample_rate(100) || mouse_set_sample_rate(80)) return 0;
+    if (mouse_command(0xF2)) return 0;
+    return mouse_read(MOUSE_TIMEOUT_MS) == 3;
 }
 
-void draw_char(uint8_t c, int x, int y, uint8_t color) {
-    if (c >= 128) return;
-    const uint8_t* glyph = font8x8_basic[c];
-    for (int row = 0; row < 8; row++) {
-        for (int col = 0; col < 8; col++) {
-            if ((glyph[row] >> col) & 1) {
-                put_pixel(x + col, y + row, color);
-            }
-        }
-    }
+/* Restores defaults (reporting off) without waiting for the ACK, so the probe can overlap other init */
+int mouse_init_begin() {
+    return mouse_write(0xF6);
 }
 
-void draw_string(const char* s, int x, int y, uint8_t color) {
-    while (*s) {
-        draw_char(*s++, x, y, color);
-        x += 8;
-    }
+/* Collects the ACK, then sets the packet format and rate and enables reporting.
+ * Returns the packet size (3, or 4 with a wheel), or -1 if no mouse answered. */
+int mouse_init_end(uint8_t sample_rate, int want_wheel) {
+    if (mouse_read(MOUSE_TIMEOUT_MS) != MOUSE_ACK) return -1;
+    int packet_size = want_wheel && mouse_enable_wheel() ? 4 : 3;
+    if (mouse_set_sample_rate(sample_rate)) return -1;
+    if (mouse_command(0xF4)) return -1;
+    return packet_size;
 }
 
-void clear_screen() {
-    fill_screen(0x00);
+/* --- PCI ---
+ * Configuration mechanism #1 through 0xCF8/0xCFC, bus 0 only.
+ */
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+#define PCI_NONE           0xFFFFFFFF
+
+uint32_t pci_read32(int dev, int fn, int offset) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | (dev << 11) | (fn << 8) | (offset & 0xFC));
+    return inl(PCI_CONFIG_DATA);
 }
 
-void draw_box(int topleftx, int toplefty, int bottomrightx, int bottomrighty, uint8_t color) {
-    if (topleftx < 0) topleftx = 0;
-    if (toplefty < 0) toplefty = 0;
-    if (bottomrightx >= VGA_MODE13_WIDTH) bottomrightx = VGA_MODE13_WIDTH - 1;
-    if (bottomrighty >= VGA_MODE13_HEIGHT) bottomrighty = VGA_MODE13_HEIGHT - 1;
+void pci_write32(int dev, int fn, int offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | (dev << 11) | (fn << 8) | (offset & 0xFC));
+    outl(PCI_CONFIG_DATA, value);
+}
 
-    for (int y = toplefty; y <= bottomrighty; y++) {
-        for (int x = topleftx; x <= bottomrightx; x++) {
-            put_pixel(x, y, color);
+/* Returns dev << 8 | fn of the first function with this class and subclass, or PCI_NONE */
+uint32_t pci_find_class(uint8_t class_code, uint8_t subclass) {
+    for (int dev = 0; dev < 32; dev++) {
+        for (int fn = 0; fn < 8; fn++) {
+            uint32_t id = pci_read32(dev, fn, 0x00);
+            if ((id & 0xFFFF) == 0xFFFF) {
+                if (fn == 0) break;
+                continue;
+            }
+            uint32_t class_reg = pci_read32(dev, fn, 0x08);
+            if ((class_reg >> 24) == class_code && ((class_reg >> 16) & 0xFF) == subclass) {
+                return (dev << 8) | fn;
+            }
+            if (fn == 0 && !(pci_read32(dev, 0, 0x0C) & 0x00800000)) break; // single function
         }
     }
+    return PCI_NONE;
 }
 
-void sort_vertices(int* x0, int* y0, int* x1, int* y1, int* x2, int* y2) {
-    if (*y0 > *y1) { int t=*y0; *y0=*y1; *y1=t; t=*x0; *x0=*x1; *x1=t; }
-    if (*y1 > *y2) { int t=*y1; *y1=*y2; *y2=t; t=*x1; *x1=*x2; *x2=t; }
-    if (*y0 > *y1) { int t=*y0; *y0=*y1; *y1=t; t=*x0; *x0=*x1; *x1=t; }
-}
+/* --- ATA ---
+ * Master drive on the primary channel, LBA28. Reads go through bus-master
+ * DMA when the IDE controller has it: one command per request with a PRD
+ * entry per destination block, so the device scatters straight into the
+ * callers' buffers, and completion is signalled by IRQ 14. Reads are still
+ * synchronous: the caller spins until that IRQ lands, so DMA saves the
+ * rep insw copy, not the wait. Without bus-master support, or if a DMA
+ * command fails, reads fall back to PIO.
+ */
+#define ATA_IO            0x1F0
+#define ATA_CONTROL       0x3F6
+#define ATA_IRQ           14
+#define ATA_REG_COUNT     2
+#define ATA_REG_LBA0      3
+#define ATA_REG_LBA1      4
+#define ATA_REG_LBA2      5
+#define ATA_REG_DRIVE     6
+#define ATA_REG_STATUS    7
+#define ATA_REG_COMMAND   7
+#define ATA_SR_ERR        0x01
+#define ATA_SR_DRQ        0x08
+#define ATA_SR_DF         0x20
+#define ATA_SR_BSY        0x80
+#define ATA_CMD_READ_PIO  0x20
+#define ATA_CMD_READ_DMA  0xC8
+#define ATA_CMD_IDENTIFY  0xEC
+#define ATA_CTRL_NIEN     0x02
+#define ATA_SECTOR_SIZE   512
+#define ATA_BLOCK_SECTORS 8   // callers read 4 KiB blocks
+#define ATA_BLOCK_SIZE    (ATA_SECTOR_SIZE * ATA_BLOCK_SECTORS)
+#define ATA_MAX_BLOCKS    16  // per command: 128 sectors, one PRD entry each
+#define ATA_TIMEOUT_MS    1000
 
-void draw_line(int x0, int y0, int x1, int y1, uint8_t color) {
-    int dx = (x1 > x0 ? x1 - x0 : x0 - x1);
-    int dy = (y1 > y0 ? y1 - y0 : y0 - y1);
-    int sx = (x0 < x1 ? 1 : -1);
-    int sy = (y0 < y1 ? 1 : -1);
-    int err = dx - dy;
+#define BM_COMMAND        0
+#define BM_STATUS         2
+#define BM_PRD_TABLE      4
+#define BM_CMD_START      0x01
+#define BM_CMD_READ       0x08  // device to memory
+#define BM_SR_ERR         0x02
+#define BM_SR_IRQ         0x04
 
-    while (1) {
-        put_pixel(x0, y0, color);
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x0 += sx; }
-        if (e2 < dx)  { err += dx; y0 += sy; }
-    }
+struct prd_entry {
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags; // bit 15: last entry
+};
+
+static struct prd_entry ata_prd[ATA_MAX_BLOCKS] __attribute__((aligned(256))); // must not cross 64 KiB
+static uint16_t ata_bm_base = 0;  // bus-master I/O base, 0 if none
+static uint32_t ata_sectors = 0;  // 0 if no drive
+static int ata_dma_enabled = 0;
+static volatile int ata_irq_done = 0;
+static volatile uint8_t ata_irq_status = 0;
+static volatile uint8_t ata_irq_bm_status = 0;
+static uint32_t ata_irq_count = 0;
+
+static inline void ata_delay() {
+    for (int i = 0; i < 4; i++) inb(ATA_CONTROL); // ~400 ns after selecting a drive
 }
 
-void fill_flat_bottom_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
-    int invslope1 = (x1 - x0) * 1000 / (y1 - y0);
-    int invslope2 = (x2 - x0) * 1000 / (y2 - y0);
+/* Waits for BSY to clear; returns the final status, or 0xFF on timeout */
+static uint8_t ata_wait_idle() {
+    uint64_t deadline = deadline_after_ms(ATA_TIMEOUT_MS);
+    do {
+        uint8_t status = inb(ATA_IO + ATA_REG_STATUS);
+        if (!(status & ATA_SR_BSY)) return status;
+    } while (!deadline_passed(deadline));
+    return 0xFF;
+}
 
-    int curx1 = x0 * 1000;
-    int curx2 = x0 * 1000;
+static int ata_wait_drq() {
+    uint8_t status = ata_wait_idle();
+    if (status == 0xFF || (status & (ATA_SR_ERR | ATA_SR_DF))) return -1;
+    return (status & ATA_SR_DRQ) ? 0 : -1;
+}
 
-    for (int y = y0; y <= y1; y++) {
-        int x_start = curx1 / 1000;
-        int x_end   = curx2 / 1000;
-        if (x_start > x_end) {
-            int t = x_start; x_start = x_end; x_end = t;
-        }
-        for (int x = x_start; x <= x_end; x++) {
-            put_pixel(x, y, color);
-        }
-        curx1 += invslope1;
-        curx2 += invslope2;
+void ata_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    if (ata_bm_base) {
+        ata_irq_bm_status = inb(ata_bm_base + BM_STATUS);
+        outb(ata_bm_base + BM_STATUS, BM_SR_IRQ); // write 1 to clear
     }
+    ata_irq_status = inb(ATA_IO + ATA_REG_STATUS); // acknowledges the drive
+    ata_irq_count++;
+    ata_irq_done = 1;
 }
 
-void fill_flat_top_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
-    int invslope1 = (x2 - x0) * 1000 / (y2 - y0);
-    int invslope2 = (x2 - x1) * 1000 / (y2 - y1);
-
-    int curx1 = x2 * 1000;
-    int curx2 = x2 * 1000;
+static void ata_issue(uint32_t lba, uint32_t sectors, uint8_t command) {
+    outb(ATA_IO + ATA_REG_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));
+    ata_delay();
+    outb(ATA_IO + ATA_REG_COUNT, (uint8_t)sectors); // 0 = 256
+    outb(ATA_IO + ATA_REG_LBA0, lba & 0xFF);
+    outb(ATA_IO + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outb(ATA_IO + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+    outb(ATA_IO + ATA_REG_COMMAND, command);
+}
 
-    for (int y = y2; y >= y0; y--) {
-        int x_start = curx1 / 1000;
-        int x_end   = curx2 / 1000;
-        if (x_start > x_end) {
-            int t = x_start; x_start = x_end; x_end = t;
+static int ata_read_pio(uint32_t lba, int count, uint8_t* const* dst) {
+    outb(ATA_CONTROL, ATA_CTRL_NIEN);
+    if (ata_wait_idle() == 0xFF) return -1;
+    ata_issue(lba, count * ATA_BLOCK_SECTORS, ATA_CMD_READ_PIO);
+    for (int i = 0; i < count; i++) {
+        for (int s = 0; s < ATA_BLOCK_SECTORS; s++) {
+            if (ata_wait_drq()) return -1;
+            void* p = dst[i] + s * ATA_SECTOR_SIZE;
+            uint32_t words = ATA_SECTOR_SIZE / 2;
+            __asm__ volatile ("rep insw" : "+D"(p), "+c"(words) : "d"((uint16_t)ATA_IO) : "memory");
         }
-        for (int x = x_start; x <= x_end; x++) {
-            put_pixel(x, y, color);
-        }
-        curx1 -= invslope1;
-        curx2 -= invslope2;
     }
+    return 0;
 }
 
-void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
-    sort_vertices(&x0, &y0, &x1, &y1, &x2, &y2);
-
-    if (y1 == y2) {
-        fill_flat_bottom_triangle(x0, y0, x1, y1, x2, y2, color);
-    } else if (y0 == y1) {
-        fill_flat_top_triangle(x0, y0, x1, y1, x2, y2, color);
-    } else {
-        int x3 = x0 + ((y1 - y0) * (x2 - x0)) / (y2 - y0);
-        int y3 = y1;
-        fill_flat_bottom_triangle(x0, y0, x1, y1, x3, y3, color);
-        fill_flat_top_triangle(x1, y1, x3, y3, x2, y2, color);
+/* Starts the transfer and spins until IRQ 14 reports completion */
+static int ata_read_dma(uint32_t lba, int count, uint8_t* const* dst) {
+    for (int i = 0; i < count; i++) {
+        ata_prd[i].addr = (uint32_t)dst[i];
+        ata_prd[i].bytes = ATA_BLOCK_SIZE;
+        ata_prd[i].flags = i == count - 1 ? 0x8000 : 0;
     }
-}
+    if (ata_wait_idle() == 0xFF) return -1;
 
-int mouse_x = VGA_MODE13_WIDTH / 2;
-int mouse_y = VGA_MODE13_HEIGHT / 2;
+    outb(ata_bm_base + BM_COMMAND, 0);
+    outl(ata_bm_base + BM_PRD_TABLE, (uint32_t)ata_prd);
+    outb(ata_bm_base + BM_STATUS, BM_SR_ERR | BM_SR_IRQ);
+    outb(ata_bm_base + BM_COMMAND, BM_CMD_READ);
+    outb(ATA_CONTROL, 0);
+    ata_irq_done = 0;
+    ata_issue(lba, count * ATA_BLOCK_SECTORS, ATA_CMD_READ_DMA);
+    outb(ata_bm_base + BM_COMMAND, BM_CMD_READ | BM_CMD_START);
 
-void draw_mouse_cursor(int x, int y, uint8_t color) {
-    put_pixel(x, y + 2, color);
-    put_pixel(x, y + 3, color);
-    put_pixel(x, y + 4, color);
-    put_pixel(x, y + 5, color);
-    put_pixel(x, y + 6, color);
-    put_pixel(x, y + 7, color);
-    put_pixel(x, y + 8, color);
-    put_pixel(x, y + 9, color);
-    put_pixel(x, y + 10, color);
-    put_pixel(x + 1, y + 3, color);
-    put_pixel(x + 1, y + 4, color);
-    put_pixel(x + 1, y + 5, color);
-    put_pixel(x + 1, y + 6, color);
-    put_pixel(x + 1, y + 7, color);
-    put_pixel(x + 1, y + 8, color);
-    put_pixel(x + 1, y + 9, color);
-    put_pixel(x + 2, y + 4, color);
-    put_pixel(x + 2, y + 5, color);
-    put_pixel(x + 2, y + 6, color);
-    put_pixel(x + 2, y + 7, color);
-    put_pixel(x + 2, y + 8, color);
-    put_pixel(x + 2, y + 9, color);
-    put_pixel(x + 3, y + 5, color);
-    put_pixel(x + 3, y + 6, color);
-    put_pixel(x + 3, y + 7, color);
-    put_pixel(x + 3, y + 8, color);
-    put_pixel(x + 3, y + 9, color);
-    put_pixel(x + 3, y + 10, color);
-    put_pixel(x + 4, y + 6, color);
-    put_pixel(x + 4, y + 7, color);
-    put_pixel(x + 4, y + 8, color);
-    put_pixel(x + 4, y + 9, color);
-    put_pixel(x + 4, y + 10, color);
-    put_pixel(x + 4, y + 11, color);
-    put_pixel(x + 5, y + 7, color);
-    put_pixel(x + 5, y + 8, color);
-    put_pixel(x + 5, y + 10, color);
-    put_pixel(x + 5, y + 11, color);
-    put_pixel(x + 5, y + 12, color);
-    put_pixel(x + 6, y + 8, color);
-    put_pixel(x + 6, y + 11, color);
-    put_pixel(x + 6, y + 12, color);
-}
-
-void draw_mouse_cursor_outline(int x, int y, uint8_t color) {
-    put_pixel(x, y + 1, color);
-    put_pixel(x - 1, y + 2, color);
-    put_pixel(x - 1, y + 3, color);
-    put_pixel(x - 1, y + 4, color);
-    put_pixel(x - 1, y + 5, color);
-    put_pixel(x - 1, y + 6, color);
-    put_pixel(x - 1, y + 7, color);
-    put_pixel(x - 1, y + 8, color);
-    put_pixel(x - 1, y + 9, color);
-    put_pixel(x - 1, y + 10, color);
-    put_pixel(x - 1, y + 11, color);
-    put_pixel(x, y + 11, color);
-    put_pixel(x + 1, y + 10, color);
-    put_pixel(x + 2, y + 10, color);
-    put_pixel(x + 3, y + 11, color);
-    put_pixel(x + 4, y + 12, color);
-    put_pixel(x + 5, y + 13, color);
-    put_pixel(x + 6, y + 13, color);
-    put_pixel(x + 7, y + 12, color);
-    put_pixel(x + 7, y + 11, color);
-    put_pixel(x + 6, y + 10, color);
-    put_pixel(x + 5, y + 9, color);
-    put_pixel(x + 6, y + 9, color);
-    put_pixel(x + 7, y + 8, color);
-    put_pixel(x + 6, y + 7, color);
-    put_pixel(x + 5, y + 6, color);
-    put_pixel(x + 4, y + 5, color);
-    put_pixel(x + 3, y + 4, color);
-    put_pixel(x + 2, y + 3, color);
-    put_pixel(x + 1, y + 2, color);
-    put_pixel(x - 1, y + 1, color);
+    uint64_t deadline = deadline_after_ms(ATA_TIMEOUT_MS);
+    while (!ata_irq_done && !deadline_passed(deadline)) __asm__ volatile ("pause");
+    outb(ata_bm_base + BM_COMMAND, 0);
+    if (!ata_irq_done) return -1;
+    if ((ata_irq_bm_status & BM_SR_ERR) || (ata_irq_status & (ATA_SR_ERR | ATA_SR_DF))) return -1;
+    return 0;
 }
 
-void erase_mouse_cursor(int x, int y) {
-    draw_mouse_cursor(x, y, 0);
+/* Reads count (<= ATA_MAX_BLOCKS) 4 KiB blocks starting at block into dst[0..count-1].
+ * Each dst must be 4 KiB aligned for DMA. Returns 0, or -1 on error. */
+int ata_read_blocks(uint32_t block, int count, uint8_t* const* dst) {
+    uint32_t lba = block * ATA_BLOCK_SECTORS;
+    if (count <= 0 || count > ATA_MAX_BLOCKS || lba + count * ATA_BLOCK_SECTORS > ata_sectors) return -1;
+
+    if (ata_dma_enabled) {
+        if (ata_read_dma(lba, count, dst) == 0) return 0;
+        serial_print("ATA: DMA read failed, falling back to PIO\n");
+        ata_dma_enabled = 0;
+    }
+    return ata_read_pio(lba, count, dst);
 }
 
-void mouse_poll() {
-    if ((inb(PS2_STATUS) & 0x21) != 0x21) return;
+/* Identifies the primary master and sets up bus-master DMA; returns 0 if a drive is usable */
+int ata_init() {
+    static uint16_t identify[256];
 
-    static uint8_t cycle = 0;
-    static uint8_t packet[3];
+    if (inb(ATA_IO + ATA_REG_STATUS) == 0xFF) return -1; // floating bus
+    outb(ATA_CONTROL, ATA_CTRL_NIEN);
+    outb(ATA_IO + ATA_REG_DRIVE, 0xA0);
+    ata_delay();
+    outb(ATA_IO + ATA_REG_COUNT, 0);
+    outb(ATA_IO + ATA_REG_LBA0, 0);
+    outb(ATA_IO + ATA_REG_LBA1, 0);
+    outb(ATA_IO + ATA_REG_LBA2, 0);
+    outb(ATA_IO + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    if (inb(ATA_IO + ATA_REG_STATUS) == 0) return -1;
+    if (ata_wait_idle() == 0xFF) return -1;
+    if (inb(ATA_IO + ATA_REG_LBA1) || inb(ATA_IO + ATA_REG_LBA2)) return -1; // ATAPI or SATA
+    if (ata_wait_drq()) return -1;
+    for (int i = 0; i < 256; i++) identify[i] = inw(ATA_IO);
 
-    packet[cycle++] = inb(PS2_DATA);
+    ata_sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    if (!(identify[49] & 0x0200) || ata_sectors == 0) { // no LBA
+        ata_sectors = 0;
+        return -1;
+    }
 
-    if (cycle < 3) return;
+    uint32_t ide = pci_find_class(0x01, 0x01);
+    if (ide != PCI_NONE && (identify[49] & 0x0100)) {
+        int dev = ide >> 8, fn = ide & 0xFF;
+        uint32_t bar4 = pci_read32(dev, fn, 0x20);
+        if (bar4 & 1) {
+            ata_bm_base = bar4 & 0xFFFC;
+            pci_write32(dev, fn, 0x04, pci_read32(dev, fn, 0x04) | 0x05); // I/O space, bus master
+            irq_install(ATA_IRQ, ata_irq);
+            ata_dma_enabled = 1;
+        }
+    }
 
-    cycle = 0;
+    serial_print("ATA: ");
+    serial_print_dec(ata_sectors / 2048);
+    serial_print(" MiB disk, ");
+    serial_print(ata_dma_enabled ? "bus-master DMA at " : "PIO only\n");
+    if (ata_dma_enabled) {
+        serial_print_hex(ata_bm_base);
+        serial_print("\n");
+    }
+    return 0;
+}
 
-    int dx = (int8_t)packet[1];
-    int dy = (int8_t)packet[2];
+/* --- Block cache ---
+ * BCACHE_BLOCKS 4 KiB blocks with LRU eviction and a chained hash on the
+ * block number. A miss right after the previous block was read starts
+ * read-ahead: up to BCACHE_READAHEAD uncached blocks go out in one ATA
+ * command, DMA'd straight into the evicted slots.
+ */
+#define BCACHE_BLOCKS    64
+#define BCACHE_BUCKETS   128 // power of two
+#define BCACHE_READAHEAD ATA_MAX_BLOCKS
+#define BCACHE_NONE      -1
 
-    erase_mouse_cursor(mouse_x, mouse_y);
+struct bcache_entry {
+    uint32_t block;
+    int16_t prev, next;    // LRU list, head = most recently used
+    int16_t hash_next;
+    uint8_t valid;
+};
 
-    mouse_x += dx;
-    mouse_y -= dy;
+struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t prefetched;   // blocks read ahead of a request
+    uint32_t evictions;
+};
 
-    if (mouse_x < 0) mouse_x = 0;
-    if (mouse_x >= VGA_MODE13_WIDTH) mouse_x = VGA_MODE13_WIDTH - 1;
-    if (mouse_y < 0) mouse_y = 0;
-    if (mouse_y >= VGA_MODE13_HEIGHT) mouse_y = VGA_MODE13_HEIGHT - 1;
+static uint8_t bcache_data[BCACHE_BLOCKS][ATA_BLOCK_SIZE] __attribute__((aligned(4096)));
+static struct bcache_entry bcache_entries[BCACHE_BLOCKS];
+static int16_t bcache_buckets[BCACHE_BUCKETS];
+static int16_t bcache_head = BCACHE_NONE;
+static int16_t bcache_tail = BCACHE_NONE;
+static uint32_t bcache_next_block = 0xFFFFFFFF; // block a sequential reader asks for next
+static struct bcache_stats bcache_stats;
 
-    draw_mouse_cursor(mouse_x, mouse_y, 0x3F);
+static void bcache_unlink(int i) {
+    struct bcache_entry* e = &bcache_entries[i];
+    if (e->prev != BCACHE_NONE) bcache_entries[e->prev].next = e->next;
+    else bcache_head = e->next;
+    if (e->next != BCACHE_NONE) bcache_entries[e->next].prev = e->prev;
+    else bcache_tail = e->prev;
 }
 
-int boxi = -20;
+static void bcache_push_front(int i) {
+    struct bcache_entry* e = &bcache_entries[i];
+    e->prev = BCACHE_NONE;
+    e->next = bcache_head;
+    if (bcache_head != BCACHE_NONE) bcache_entries[bcache_head].prev = i;
+    bcache_head = i;
+    if (bcache_tail == BCACHE_NONE) bcache_tail = i;
+}
 
-void kernel_main() {
-    serial_init();
-    serial_print("Measuring CPU frequency...\n");
-    uint64_t cpu_freq = measure_cpu_frequency();
+static void bcache_push_back(int i) {
+    struct bcache_entry* e = &bcache_entries[i];
+    e->next = BCACHE_NONE;
+    e->prev = bcache_tail;
+    if (bcache_tail != BCACHE_NONE) bcache_entries[bcache_tail].next = i;
+    bcache_tail = i;
+    if (bcache_head == BCACHE_NONE) bcache_head = i;
+}
 
-    uint64_t ticks_per_ms = cpu_freq / 1000;
-    uint64_t last_render_time = rdtsc();
+static int bcache_find(uint32_t block) {
+    for (int i = bcache_buckets[block & (BCACHE_BUCKETS - 1)]; i != BCACHE_NONE; i = bcache_entries[i].hash_next) {
+        if (bcache_entries[i].block == block) return i;
+    }
+    return BCACHE_NONE;
+}
 
-    serial_print("Serial works! Trying VGA 0x13...\n");
-    set_vga_mode_13();
-    serial_print("VGA works! Trying mouse...\n");
-    mouse_init();
-    serial_print("Mouse works! Continuing...\n");
+static void bcache_unhash(int i) {
+    int16_t* link = &bcache_buckets[bcache_entries[i].block & (BCACHE_BUCKETS - 1)];
+    while (*link != i) link = &bcache_entries[*link].hash_next;
+    *link = bcache_entries[i].hash_next;
+}
 
-    clear_screen();
+/* Drops every cached block and resets the counters */
+void bcache_init() {
+    bcache_head = bcache_tail = BCACHE_NONE;
+    for (int i = 0; i < BCACHE_BUCKETS; i++) bcache_buckets[i] = BCACHE_NONE;
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        bcache_entries[i].valid = 0;
+        bcache_push_back(i);
+    }
+    bcache_next_block = 0xFFFFFFFF;
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+}
+
+/* Returns the cached contents of a 4 KiB block, or NULL on a read error.
+ * The pointer stays valid until the next bcache_read. */
+const uint8_t* bcache_read(uint32_t block) {
+    int sequential = block == bcache_next_block;
+    bcache_next_block = block + 1;
+
+    int i = bcache_find(block);
+    if (i != BCACHE_NONE) {
+        bcache_stats.hits++;
+        bcache_unlink(i);
+        bcache_push_front(i);
+        return bcache_data[i];
+    }
+    bcache_stats.misses++;
+
+    uint32_t disk_blocks = ata_sectors / ATA_BLOCK_SECTORS;
+    int count = 1;
+    if (sequential) {
+        while (count < BCACHE_READAHEAD && block + count < disk_blocks && bcache_find(block + count) == BCACHE_NONE) {
+            count++;
+        }
+    }
+
+    // Take victims from the LRU end; slot[0] gets the requested block
+    int16_t slots[BCACHE_READAHEAD];
+    uint8_t* dst[BCACHE_READAHEAD];
+    for (int k = 0; k < count; k++) {
+        int v = bcache_tail;
+        bcache_unlink(v);
+        if (bcache_entries[v].valid) {
+            bcache_unhash(v);
+            bcache_entries[v].valid = 0;
+            bcache_stats.evictions++;
+        }
+        slots[k] = v;
+        dst[k] = bcache_data[v];
+    }
+
+    if (ata_read_blocks(block, count, dst) != 0) {
+        for (int k = 0; k < count; k++) bcache_push_back(slots[k]);
+        return NULL;
+    }
+
+    for (int k = count - 1; k >= 0; k--) {
+        struct bcache_entry* e = &bcache_entries[slots[k]];
+        e->block = block + k;
+        e->valid = 1;
+        e->hash_next = bcache_buckets[e->block & (BCACHE_BUCKETS - 1)];
+        bcache_buckets[e->block & (BCACHE_BUCKETS - 1)] = slots[k];
+        bcache_push_front(slots[k]);
+    }
+    bcache_stats.prefetched += count - 1;
+    return bcache_data[slots[0]];
+}
+
+/* --- Mixer ---
+ * Voices play a FIX_ANGLES-entry wavetable at any pitch: the phase is a
+ * 16.16 table index advanced by a per-voice step, so pitch costs nothing
+ * per sample. Volume is 16.16 on a 0-256 scale and decays linearly to zero
+ * over the note. Voices sum into 32 bits and are clamped to 16 once, so
+ * loud chords saturate instead of wrapping. mixer_fill runs in the sound
+ * card's IRQ; sound_play hands a voice over with interrupts held off.
+ */
+#define MIXER_VOICES    8
+#define MIXER_WAVE_SIZE FIX_ANGLES
+#define MIXER_MAX_BLOCK 1024 // samples per mixer_fill
+
+struct mixer_voice {
+    const int16_t* wave;
+    uint32_t phase;     // 16.16 index into wave
+    uint32_t step;
+    int32_t volume;     // 16.16, 256.0 = full scale
+    int32_t decay;      // taken off volume every sample
+    uint32_t remaining; // samples left
+    int active;
+};
+
+struct mixer_stats {
+    uint32_t buffers;
+    uint32_t underruns; // halves the card reached before they were refilled
+    uint32_t cycles_last, cycles_max;
+    uint64_t cycles_total;
+};
+
+static int16_t mixer_sine[MIXER_WAVE_SIZE];
+static int16_t mixer_square[MIXER_WAVE_SIZE];
+static struct mixer_voice mixer_voices[MIXER_VOICES];
+static struct mixer_stats mixer_stats;
+static int32_t mixer_accum[MIXER_MAX_BLOCK];
+static uint32_t mixer_rate = 0; // 0 until a card plays
+
+void mixer_init(uint32_t rate) {
+    for (int i = 0; i < MIXER_WAVE_SIZE; i++) {
+        mixer_sine[i] = (int16_t)((fix_sin_table[i] * 32767) >> 16);
+        mixer_square[i] = i < MIXER_WAVE_SIZE / 2 ? 12000 : -12000;
+    }
+    memset(mixer_voices, 0, sizeof(mixer_voices));
+    memset(&mixer_stats, 0, sizeof(mixer_stats));
+    mixer_rate = rate;
+}
+
+/* Mixes the next n samples (n <= MIXER_MAX_BLOCK) into out; called from the IRQ */
+void mixer_fill(int16_t* out, int n) {
+    uint64_t start = rdtsc();
+
+    memset(mixer_accum, 0, n * sizeof(mixer_accum[0]));
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        struct mixer_voice* voice = &mixer_voices[v];
+        if (!voice->active) continue;
+
+        const int16_t* wave = voice->wave;
+        uint32_t phase = voice->phase, step = voice->step;
+        int32_t volume = voice->volume, decay = voice->decay;
+        int count = voice->remaining < (uint32_t)n ? (int)voice->remaining : n;
+        int i;
+        for (i = 0; i < count && volume > 0; i++) {
+            mixer_accum[i] += (wave[(phase >> 16) & (MIXER_WAVE_SIZE - 1)] * (volume >> 16)) >> 8;
+            phase += step;
+            volume -= decay;
+        }
+        voice->phase = phase;
+        voice->volume = volume;
+        voice->remaining -= i;
+        if (voice->remaining == 0 || volume <= 0) voice->active = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        int32_t s = mixer_accum[i];
+        out[i] = s > 32767 ? 32767 : s < -32768 ? -32768 : (int16_t)s;
+    }
+
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+    mixer_stats.buffers++;
+    mixer_stats.cycles_last = cycles;
+    mixer_stats.cycles_total += cycles;
+    if (cycles > mixer_stats.cycles_max) mixer_stats.cycles_max = cycles;
+}
+
+/* Starts a note fading out over ms; volume 0-256. Returns -1 with no card or no free voice */
+int sound_play(const int16_t* wave, uint32_t freq, int volume, uint32_t ms) {
+    if (!mixer_rate || volume <= 0) return -1;
+    uint32_t samples = ms * mixer_rate / 1000;
+    if (samples == 0) return -1;
+
+    uint32_t flags = irq_save();
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        struct mixer_voice* voice = &mixer_voices[v];
+        if (voice->active) continue;
+        voice->wave = wave;
+        voice->phase = 0;
+        voice->step = (uint32_t)(((uint64_t)freq * MIXER_WAVE_SIZE << 16) / mixer_rate);
+        voice->volume = volume << 16;
+        voice->decay = (volume << 16) / samples;
+        voice->remaining = samples;
+        voice->active = 1;
+        irq_restore(flags);
+        return v;
+    }
+    irq_restore(flags);
+    return -1;
+}
+
+/* --- Sound Blaster 16 ---
+ * 16-bit mono output through ISA DMA channel 5 in auto-init mode over one
+ * buffer split in halves. The DSP raises IRQ 5 each time it finishes a
+ * half, and the handler mixes the next audio into the half just played
+ * while the card carries on with the other one, so nothing ever polls and
+ * rendering can take as long as it likes. If the DMA position is already
+ * back in the half being refilled, the IRQ came too late and the card
+ * replayed stale samples: that counts as an underrun.
+ */
+#define SB16_BASE         0x220
+#define SB16_MIXER_ADDR   (SB16_BASE + 0x4)
+#define SB16_MIXER_DATA   (SB16_BASE + 0x5)
+#define SB16_RESET        (SB16_BASE + 0x6)
+#define SB16_READ         (SB16_BASE + 0xA)
+#define SB16_WRITE        (SB16_BASE + 0xC)
+#define SB16_READ_STATUS  (SB16_BASE + 0xE)
+#define SB16_ACK16        (SB16_BASE + 0xF)
+#define SB16_IRQ          5
+#define SB16_RATE         22050
+#define SB16_HALF         512 // samples, about 23 ms
+#define SB16_TIMEOUT_MS   10
+
+#define DSP_SET_RATE      0x41
+#define DSP_PLAY16_AUTO   0xB6 // 16-bit, D/A, auto-init, FIFO on
+#define DSP_MODE_MONO_S   0x10 // mono, signed
+#define DSP_SPEAKER_ON    0xD1
+#define DSP_VERSION       0xE1
+
+#define DMA2_MASK         0xD4
+#define DMA2_MODE         0xD6
+#define DMA2_CLEAR        0xD8
+#define DMA5_ADDR         0xC4
+#define DMA5_COUNT        0xC6
+#define DMA5_PAGE         0x8B
+#define DMA_MODE_PLAYBACK 0x58 // single transfer, auto-init, memory to device
+
+// 2 KiB on a 4 KiB boundary, so it cannot straddle a 64 or 128 KiB ISA DMA page
+static int16_t sb16_buffer[SB16_HALF * 2] __attribute__((aligned(4096)));
+static int sb16_next_half = 0;
+static uint16_t sb16_version = 0;
+static int sb16_playing = 0;
+
+static int sb16_dsp_write(uint8_t v) {
+    uint64_t deadline = deadline_after_ms(SB16_TIMEOUT_MS);
+    while (inb(SB16_WRITE) & 0x80) {
+        if (deadline_passed(deadline)) return -1;
+    }
+    outb(SB16_WRITE, v);
+    return 0;
+}
+
+static int sb16_dsp_read() {
+    uint64_t deadline = deadline_after_ms(SB16_TIMEOUT_MS);
+    while (!(inb(SB16_READ_STATUS) & 0x80)) {
+        if (deadline_passed(deadline)) return -1;
+    }
+    return inb(SB16_READ);
+}
+
+static void sb16_mixer_write(uint8_t reg, uint8_t v) {
+    outb(SB16_MIXER_ADDR, reg);
+    outb(SB16_MIXER_DATA, v);
+}
+
+// Samples the card has consumed from the start of sb16_buffer
+static uint32_t sb16_dma_position() {
+    outb(DMA2_CLEAR, 0);
+    uint32_t left = inb(DMA5_COUNT);
+    left |= inb(DMA5_COUNT) << 8;
+    return (SB16_HALF * 2 - 1 - left) % (SB16_HALF * 2);
+}
+
+void sb16_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    outb(SB16_MIXER_ADDR, 0x82); // interrupt status
+    if (!(inb(SB16_MIXER_DATA) & 0x02)) return;
+    inb(SB16_ACK16);
+
+    int half = sb16_next_half;
+    sb16_next_half ^= 1;
+    if ((sb16_dma_position() >= SB16_HALF) == (half == 1)) mixer_stats.underruns++;
+    mixer_fill(sb16_buffer + half * SB16_HALF, SB16_HALF);
+}
+
+/* Finds the card and starts the endless DMA loop; returns 0 if it plays */
+int sb16_init() {
+    outb(SB16_RESET, 1);
+    uint64_t until = rdtsc() + tsc_per_ms / 100; // 10 us, 3 needed
+    while (rdtsc() < until);
+    outb(SB16_RESET, 0);
+    if (sb16_dsp_read() != 0xAA) return -1;
+
+    if (sb16_dsp_write(DSP_VERSION)) return -1;
+    int major = sb16_dsp_read(), minor = sb16_dsp_read();
+    if (major < 4 || minor < 0) return -1; // 16-bit DMA needs a DSP 4.xx
+    sb16_version = major << 8 | minor;
+
+    sb16_mixer_write(0x80, 0x02);        // IRQ 5
+    sb16_mixer_write(0x81, 0x02 | 0x20); // DMA 1 and 5
+
+    mixer_init(SB16_RATE);
+    mixer_fill(sb16_buffer, SB16_HALF);
+    mixer_fill(sb16_buffer + SB16_HALF, SB16_HALF);
+    sb16_next_half = 0;
+
+    uint32_t phys = (uint32_t)sb16_buffer;
+    uint32_t words = SB16_HALF * 2;
+    outb(DMA2_MASK, 0x04 | 1);
+    outb(DMA2_CLEAR, 0);
+    outb(DMA2_MODE, DMA_MODE_PLAYBACK | 1);
+    outb(DMA5_ADDR, (phys >> 1) & 0xFF);
+    outb(DMA5_ADDR, (phys >> 9) & 0xFF);
+    outb(DMA5_COUNT, (words - 1) & 0xFF);
+    outb(DMA5_COUNT, (words - 1) >> 8);
+    outb(DMA5_PAGE, (phys >> 16) & 0xFE);
+    outb(DMA2_MASK, 1);
+
+    // The first half-buffer IRQ is 23 ms away and the PIC latches it while
+    // IRQ 5 is still masked, so the handler goes in only once the DSP took
+    // every command; a failed setup leaves nothing live behind
+    if (sb16_dsp_write(DSP_SET_RATE) || sb16_dsp_write(SB16_RATE >> 8) || sb16_dsp_write(SB16_RATE & 0xFF) ||
+        sb16_dsp_write(DSP_PLAY16_AUTO) || sb16_dsp_write(DSP_MODE_MONO_S) ||
+        sb16_dsp_write((SB16_HALF - 1) & 0xFF) || sb16_dsp_write((SB16_HALF - 1) >> 8) ||
+        sb16_dsp_write(DSP_SPEAKER_ON)) {
+        outb(DMA2_MASK, 0x04 | 1); // stop channel 5's auto-init transfer
+        mixer_rate = 0;
+        return -1;
+    }
+    irq_install_fpu(SB16_IRQ, sb16_irq); // mixer_fill clears its accumulator with memset
+    sb16_playing = 1;
+    return 0;
+}
+
+void sb16_report() {
+    if (!sb16_playing) {
+        serial_print("sound: no Sound Blaster 16\n");
+        return;
+    }
+    uint32_t flags = irq_save();
+    struct mixer_stats s = mixer_stats;
+    irq_restore(flags);
+    int voices = 0;
+    for (int v = 0; v < MIXER_VOICES; v++) voices += mixer_voices[v].active;
+
+    serial_print("sound: ");
+    serial_print_dec(SB16_RATE);
+    serial_print(" Hz, ");
+    serial_print_dec(s.buffers);
+    serial_print(" buffers, ");
+    serial_print_dec(s.underruns);
+    serial_print(" underruns, ");
+    serial_print_dec(voices);
+    serial_print(" voices playing; mixer cycles/buffer last ");
+    serial_print_dec(s.cycles_last);
+    serial_print(" mean ");
+    serial_print_dec(s.buffers ? s.cycles_total / s.buffers : 0);
+    serial_print(" max ");
+    serial_print_dec(s.cycles_max);
+    serial_print("\n");
+}
+
+/* --- Raster kernels ---
+ * The hot inner loops come in i386, MMX and SSE2 builds inside the same
+ * kernel.elf. raster_init() fills the raster table from the CPUID bits once
+ * at boot. fill_span writes n pixels of one color. expand_mask writes color
+ * wherever a bit is set in a 1bpp mask (bit 0 = leftmost pixel), rows * bytes
+ * of mask at a time. The SIMD versions read the color broadcast from memory
+ * in each asm block rather than keeping it in a vector register between
+ * blocks: nothing would tell the compiler that register is live. That copy
+ * sits on the stack, so it is loaded unaligned and does not depend on how
+ * the caller's stack happens to be aligned.
+ */
+struct raster_ops {
+    const char* name;
+    void* (*fill_span)(void* dst, int color, size_t n);
+    void (*expand_mask)(uint8_t* dst, int pitch, const uint8_t* bits, int bytes_per_row, int rows, uint8_t color);
+};
+
+/* glyph_masks[b] has byte i = 0xFF where bit i of b is set */
+static uint32_t glyph_masks[256][2] __attribute__((aligned(16)));
+
+void expand_mask_i386(uint8_t* dst, int pitch, const uint8_t* bits, int bytes_per_row, int rows, uint8_t color) {
+    uint32_t c = color * 0x01010101u;
+    for (int row = 0; row < rows; row++) {
+        uint32_t* d = (uint32_t*)dst;
+        for (int i = 0; i < bytes_per_row; i++, d += 2) {
+            uint8_t b = bits[i];
+            if (!b) continue;
+            const uint32_t* m = glyph_masks[b];
+            d[0] = (d[0] & ~m[0]) | (c & m[0]);
+            d[1] = (d[1] & ~m[1]) | (c & m[1]);
+        }
+        bits += bytes_per_row;
+        dst += pitch;
+    }
+}
+
+void expand_mask_mmx(uint8_t* dst, int pitch, const uint8_t* bits, int bytes_per_row, int rows, uint8_t color) {
+    const uint32_t c[2] __attribute__((aligned(8))) = { color * 0x01010101u, color * 0x01010101u };
+    for (int row = 0; row < rows; row++) {
+        uint8_t* d = dst;
+        for (int i = 0; i < bytes_per_row; i++, d += 8) {
+            uint8_t b = bits[i];
+            if (!b) continue;
+            __asm__ volatile (
+                "movq (%0), %%mm0\n\t"
+                "movq (%1), %%mm1\n\t"
+                "movq %2, %%mm2\n\t"
+                "pand %%mm0, %%mm2\n\t"
+                "pandn %%mm1, %%mm0\n\t"
+                "por %%mm2, %%mm0\n\t"
+                "movq %%mm0, (%1)"
+                : : "r"(glyph_masks[b]), "r"(d), "m"(c) : "memory");
+        }
+        bits += bytes_per_row;
+        dst += pitch;
+    }
+    __asm__ volatile ("emms");
+}
+
+void expand_mask_sse2(uint8_t* dst, int pitch, const uint8_t* bits, int bytes_per_row, int rows, uint8_t color) {
+    const uint32_t v = color * 0x01010101u;
+    const uint32_t c[4] = { v, v, v, v };
+    for (int row = 0; row < rows; row++) {
+        uint8_t* d = dst;
+        int i = 0;
+        // 16 pixels per store from two mask bytes
+        for (; i + 1 < bytes_per_row; i += 2, d += 16) {
+            if (!(bits[i] | bits[i + 1])) continue;
+            __asm__ volatile (
+                "movq (%0), %%xmm0\n\t"
+                "movhps (%1), %%xmm0\n\t"
+                "movdqu (%2), %%xmm1\n\t"
+                "movdqu %3, %%xmm2\n\t"
+                "pand %%xmm0, %%xmm2\n\t"
+                "pandn %%xmm1, %%xmm0\n\t"
+                "por %%xmm2, %%xmm0\n\t"
+                "movdqu %%xmm0, (%2)"
+                : : "r"(glyph_masks[bits[i]]), "r"(glyph_masks[bits[i + 1]]), "r"(d), "m"(c) : "memory");
+        }
+        if (i < bytes_per_row && bits[i]) {
+            __asm__ volatile (
+                "movq (%0), %%xmm0\n\t"
+                "movq (%1), %%xmm1\n\t"
+                "movdqu %2, %%xmm2\n\t"
+                "pand %%xmm0, %%xmm2\n\t"
+                "pandn %%xmm1, %%xmm0\n\t"
+                "por %%xmm2, %%xmm0\n\t"
+                "movq %%xmm0, (%1)"
+                : : "r"(glyph_masks[bits[i]]), "r"(d), "m"(c) : "memory");
+        }
+        bits += bytes_per_row;
+        dst += pitch;
+    }
+}
+
+static const struct raster_ops raster_i386 = { "i386", memset_rep,  expand_mask_i386 };
+static const struct raster_ops raster_mmx  = { "MMX",  memset_mmx,  expand_mask_mmx };
+static const struct raster_ops raster_sse2 = { "SSE2", memset_sse2, expand_mask_sse2 };
+static const struct raster_ops* raster = &raster_i386;
+
+void raster_init() {
+    for (int b = 0; b < 256; b++) {
+        uint8_t* m = (uint8_t*)glyph_masks[b];
+        for (int i = 0; i < 8; i++) {
+            m[i] = (b >> i) & 1 ? 0xFF : 0x00;
+        }
+    }
+
+    if (cpu_can_use_sse2()) raster = &raster_sse2;
+    else if (cpu_can_use_mmx()) raster = &raster_mmx;
+    else raster = &raster_i386;
+
+    serial_print("raster: using ");
+    serial_print(raster->name);
+    serial_print(" path\n");
+}
+
+extern const uint8_t font8x8_basic[128][8];
+
+void put_pixel(int x, int y, uint8_t color) {
+    if (x < 0 || x >= VGA_MODE13_WIDTH || y < 0 || y >= VGA_MODE13_HEIGHT) return;
+    uint8_t* vga = (uint8_t*)VGA_MODE13_ADDR;
+    vga[y * VGA_MODE13_WIDTH + x] = color;
+}
+
+void fill_screen(uint8_t color) {
+    raster->fill_span(VGA_MODE13_ADDR, color, VGA_MODE13_WIDTH * VGA_MODE13_HEIGHT);
+}
+
+/* Fills x0..x1 inclusive on row y, clipped to the screen */
+void draw_hspan(int x0, int x1, int y, uint8_t color) {
+    if (y < 0 || y >= VGA_MODE13_HEIGHT) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= VGA_MODE13_WIDTH) x1 = VGA_MODE13_WIDTH - 1;
+    if (x0 > x1) return;
+    raster->fill_span(VGA_MODE13_ADDR + y * VGA_MODE13_WIDTH + x0, color, x1 - x0 + 1);
+}
+
+void draw_char(uint8_t c, int x, int y, uint8_t color) {
+    if (c >= 128) return;
+    const uint8_t* glyph = font8x8_basic[c];
+    if (x >= 0 && y >= 0 && x + 8 <= VGA_MODE13_WIDTH && y + 8 <= VGA_MODE13_HEIGHT) {
+        raster->expand_mask(VGA_MODE13_ADDR + y * VGA_MODE13_WIDTH + x, VGA_MODE13_WIDTH, glyph, 1, 8, color);
+        return;
+    }
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if ((glyph[row] >> col) & 1) {
+                put_pixel(x + col, y + row, color);
+            }
+        }
+    }
+}
+
+void draw_string(const char* s, int x, int y, uint8_t color) {
+    while (*s) {
+        draw_char(*s++, x, y, color);
+        x += 8;
+    }
+}
+
+void clear_screen() {
+    fill_screen(0x00);
+}
+
+void draw_box(int topleftx, int toplefty, int bottomrightx, int bottomrighty, uint8_t color) {
+    if (topleftx < 0) topleftx = 0;
+    if (toplefty < 0) toplefty = 0;
+    if (bottomrightx >= VGA_MODE13_WIDTH) bottomrightx = VGA_MODE13_WIDTH - 1;
+    if (bottomrighty >= VGA_MODE13_HEIGHT) bottomrighty = VGA_MODE13_HEIGHT - 1;
+
+    if (topleftx > bottomrightx) return;
+
+    uint8_t* row = VGA_MODE13_ADDR + toplefty * VGA_MODE13_WIDTH + topleftx;
+    for (int y = toplefty; y <= bottomrighty; y++, row += VGA_MODE13_WIDTH) {
+        raster->fill_span(row, color, bottomrightx - topleftx + 1);
+    }
+}
+
+void sort_vertices(int* x0, int* y0, int* x1, int* y1, int* x2, int* y2) {
+    if (*y0 > *y1) { int t=*y0; *y0=*y1; *y1=t; t=*x0; *x0=*x1; *x1=t; }
+    if (*y1 > *y2) { int t=*y1; *y1=*y2; *y2=t; t=*x1; *x1=*x2; *x2=t; }
+    if (*y0 > *y1) { int t=*y0; *y0=*y1; *y1=t; t=*x0; *x0=*x1; *x1=t; }
+}
+
+/* --- Glyph atlas ---
+ * font8x8_basic prescaled to 2x, 3x and 4x once at boot. Glyph c at scale s
+ * is 8 * s rows of s mask bytes: each font pixel is widened to s bits and
+ * each font row repeated s times. draw_char_scaled hands a glyph's whole
+ * block to expand_mask with s bytes per row, so scaled text runs the same
+ * kernel as 1x text at about the same cost per pixel, instead of one box
+ * per font pixel.
+ */
+#define GLYPH_MAX_SCALE  4
+#define GLYPH_ATLAS_SIZE (128 * 8 * (2 * 2 + 3 * 3 + 4 * 4))
+
+static uint8_t glyph_atlas[GLYPH_ATLAS_SIZE];
+static uint32_t glyph_atlas_offset[GLYPH_MAX_SCALE + 1]; // where scales 2..GLYPH_MAX_SCALE start
+
+static inline const uint8_t* glyph_atlas_get(uint8_t c, int scale) {
+    return glyph_atlas + glyph_atlas_offset[scale] + c * 8 * scale * scale;
+}
+
+void glyph_atlas_init() {
+    uint32_t offset = 0;
+    for (int scale = 2; scale <= GLYPH_MAX_SCALE; scale++) {
+        glyph_atlas_offset[scale] = offset;
+        uint8_t* out = glyph_atlas + offset;
+        for (int c = 0; c < 128; c++) {
+            for (int row = 0; row < 8; row++) {
+                uint32_t wide = 0;
+                for (int col = 0; col < 8; col++) {
+                    if ((font8x8_basic[c][row] >> col) & 1) wide |= ((1u << scale) - 1) << (col * scale);
+                }
+                for (int r = 0; r < scale; r++, out += scale) {
+                    for (int i = 0; i < scale; i++) out[i] = (uint8_t)(wide >> (8 * i));
+                }
+            }
+        }
+        offset += 128 * 8 * scale * scale;
+    }
+}
+
+/* Draws c as an 8 * scale pixel square; scales above GLYPH_MAX_SCALE draw nothing */
+void draw_char_scaled(uint8_t c, int x, int y, int scale, uint8_t color) {
+    if (scale <= 1) {
+        draw_char(c, x, y, color);
+        return;
+    }
+    if (c >= 128 || scale > GLYPH_MAX_SCALE) return;
+
+    const uint8_t* bits = glyph_atlas_get(c, scale);
+    int size = 8 * scale;
+    if (x >= 0 && y >= 0 && x + size <= VGA_MODE13_WIDTH && y + size <= VGA_MODE13_HEIGHT) {
+        raster->expand_mask(VGA_MODE13_ADDR + y * VGA_MODE13_WIDTH + x, VGA_MODE13_WIDTH, bits, scale, size, color);
+        return;
+    }
+    for (int row = 0; row < size; row++, bits += scale) {
+        for (int col = 0; col < size; col++) {
+            if ((bits[col >> 3] >> (col & 7)) & 1) {
+                put_pixel(x + col, y + row, color);
+            }
+        }
+    }
+}
+
+void draw_string_scaled(const char* s, int x, int y, int scale, uint8_t color) {
+    int advance = 8 * (scale > 1 ? scale : 1);
+    while (*s) {
+        draw_char_scaled(*s++, x, y, scale, color);
+        x += advance;
+    }
+}
+
+/* --- Blend tables ---
+ * Translucency and shading by table lookup, so a blended pixel costs one
+ * load more than an opaque one. blend_table[src][dst] is the entry nearest
+ * to the 50/50 mix of two colors; shade_table[level][c] is the entry nearest
+ * to c scaled by level / (SHADE_LEVELS - 1), the top level being c itself.
+ * Both follow palette_base and are brought up to date on first use after
+ * palette_generation moves (fading the shadow palette does not count). Only
+ * entries that really differ from the last build count: if they are all
+ * volatile, just their rows and columns are redone, so cycling animated
+ * colors stays cheap; any other change rebuilds everything, since it moves
+ * the candidates every search picks from. The nearest-color search keeps the candidates sorted by green and walks
+ * outward from the target's green until green alone is farther than the
+ * best match so far.
+ */
+#define SHADE_LEVELS 16
+
+static uint8_t blend_table[256][256];
+static uint8_t shade_table[SHADE_LEVELS][256];
+static uint32_t blend_generation = 0xFFFFFFFF;
+static uint8_t blend_palette[256][3]; // palette_base as of the last build
+static uint8_t blend_volatile[256];
+static uint8_t blend_by_green[256];
+static uint16_t blend_green_start[64]; // first candidate with at least that green
+static int blend_candidates = 0;
+
+// Weighted squared distance, green counting most
+static inline int blend_try(int i, int r, int g, int b, int* best, int* best_index) {
+    const uint8_t* c = palette_base[blend_by_green[i]];
+    int dg = 4 * (c[1] - g) * (c[1] - g);
+    if (dg >= *best) return 0;
+    int d = 2 * (c[0] - r) * (c[0] - r) + dg + 3 * (c[2] - b) * (c[2] - b);
+    if (d < *best) {
+        *best = d;
+        *best_index = blend_by_green[i];
+    }
+    return 1;
+}
+
+/* Palette entry closest to a 6-bit color, volatile entries excluded */
+int palette_nearest(int r, int g, int b) {
+    int best = 0x7FFFFFFF, best_index = 0;
+    int start = blend_green_start[g];
+    for (int i = start; i < blend_candidates && blend_try(i, r, g, b, &best, &best_index); i++);
+    for (int i = start - 1; i >= 0 && blend_try(i, r, g, b, &best, &best_index); i--);
+    return best_index;
+}
+
+static inline uint8_t blend_mix(int s, int d) {
+    const uint8_t* a = palette_base[s];
+    const uint8_t* b = palette_base[d];
+    if (s == d && !palette_volatile[s]) return s;
+    return palette_nearest((a[0] + b[0] + 1) >> 1, (a[1] + b[1] + 1) >> 1, (a[2] + b[2] + 1) >> 1);
+}
+
+static inline uint8_t blend_shade(int c, int level) {
+    const uint8_t* a = palette_base[c];
+    if (level == SHADE_LEVELS - 1 && !palette_volatile[c]) return c;
+    return palette_nearest(a[0] * level / (SHADE_LEVELS - 1), a[1] * level / (SHADE_LEVELS - 1),
+                           a[2] * level / (SHADE_LEVELS - 1));
+}
+
+void blend_build() {
+    blend_candidates = 0;
+    for (int g = 0; g < 64; g++) {
+        blend_green_start[g] = blend_candidates;
+        for (int i = 0; i < 256; i++) {
+            if (!palette_volatile[i] && palette_base[i][1] == g) blend_by_green[blend_candidates++] = i;
+        }
+    }
+
+    for (int s = 0; s < 256; s++) {
+        for (int d = 0; d <= s; d++) blend_table[s][d] = blend_table[d][s] = blend_mix(s, d);
+    }
+    for (int level = 0; level < SHADE_LEVELS; level++) {
+        for (int c = 0; c < 256; c++) shade_table[level][c] = blend_shade(c, level);
+    }
+    memcpy(blend_palette, palette_base, sizeof(blend_palette));
+    memcpy(blend_volatile, palette_volatile, sizeof(blend_volatile));
+    blend_generation = palette_generation;
+}
+
+void blend_report() {
+    serial_print("blend tables: ");
+    serial_print_dec((sizeof(blend_table) + sizeof(shade_table)) / 1024);
+    serial_print(" KB for ");
+    serial_print_dec(blend_candidates);
+    serial_print(" colors\n");
+}
+
+/* Redoes the rows and columns of changed volatile entries, or everything if any other entry changed */
+static void blend_refresh() {
+    for (int i = 0; i < 256; i++) {
+        if (palette_volatile[i] != blend_volatile[i] ||
+            (!palette_volatile[i] && memcmp(palette_base[i], blend_palette[i], 3) != 0)) {
+            blend_build();
+            return;
+        }
+    }
+    for (int s = 0; s < 256; s++) {
+        if (memcmp(palette_base[s], blend_palette[s], 3) == 0) continue;
+        for (int d = 0; d < 256; d++) blend_table[s][d] = blend_table[d][s] = blend_mix(s, d);
+        for (int level = 0; level < SHADE_LEVELS; level++) shade_table[level][s] = blend_shade(s, level);
+        memcpy(blend_palette[s], palette_base[s], 3);
+    }
+    blend_generation = palette_generation;
+}
+
+static inline void blend_update() {
+    if (blend_generation != palette_generation) blend_refresh();
+}
+
+static inline const uint8_t* shade_for(int level) {
+    if (level < 0) level = 0;
+    if (level >= SHADE_LEVELS) level = SHADE_LEVELS - 1;
+    return shade_table[level];
+}
+
+// Maps n pixels through a 256-entry table, a dword at a time where aligned
+static void blend_span(uint8_t* d, const uint8_t* t, int n) {
+    for (; n > 0 && ((uintptr_t)d & 3); n--, d++) *d = t[*d];
+    for (; n >= 4; n -= 4, d += 4) {
+        uint32_t v = *(uint32_t*)d;
+        *(uint32_t*)d = t[v & 0xFF] | t[(v >> 8) & 0xFF] << 8 | t[(v >> 16) & 0xFF] << 16 | (uint32_t)t[v >> 24] << 24;
+    }
+    for (; n > 0; n--, d++) *d = t[*d];
+}
+
+// Same clipping as draw_box, corners inclusive
+static void blend_box(int x0, int y0, int x1, int y1, const uint8_t* t) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= VGA_MODE13_WIDTH) x1 = VGA_MODE13_WIDTH - 1;
+    if (y1 >= VGA_MODE13_HEIGHT) y1 = VGA_MODE13_HEIGHT - 1;
+    if (x0 > x1) return;
+
+    uint8_t* row = VGA_MODE13_ADDR + y0 * VGA_MODE13_WIDTH + x0;
+    for (int y = y0; y <= y1; y++, row += VGA_MODE13_WIDTH) blend_span(row, t, x1 - x0 + 1);
+}
+
+/* Mixes color half into x0..x1 on row y */
+void draw_hspan_blend(int x0, int x1, int y, uint8_t color) {
+    blend_update();
+    blend_box(x0, y, x1, y, blend_table[color]);
+}
+
+/* Darkens x0..x1 on row y to level (0 black, SHADE_LEVELS - 1 unchanged) */
+void draw_hspan_shade(int x0, int x1, int y, int level) {
+    blend_update();
+    blend_box(x0, y, x1, y, shade_for(level));
+}
+
+void draw_box_blend(int topleftx, int toplefty, int bottomrightx, int bottomrighty, uint8_t color) {
+    blend_update();
+    blend_box(topleftx, toplefty, bottomrightx, bottomrighty, blend_table[color]);
+}
+
+void draw_box_shade(int topleftx, int toplefty, int bottomrightx, int bottomrighty, int level) {
+    blend_update();
+    blend_box(topleftx, toplefty, bottomrightx, bottomrighty, shade_for(level));
+}
+
+void draw_char_blend(uint8_t c, int x, int y, uint8_t color) {
+    if (c >= 128) return;
+    blend_update();
+    const uint8_t* glyph = font8x8_basic[c];
+    const uint8_t* t = blend_table[color];
+    for (int row = 0; row < 8; row++) {
+        if (y + row < 0 || y + row >= VGA_MODE13_HEIGHT) continue;
+        uint8_t* d = VGA_MODE13_ADDR + (y + row) * VGA_MODE13_WIDTH + x;
+        for (int col = 0; col < 8; col++) {
+            if (((glyph[row] >> col) & 1) && x + col >= 0 && x + col < VGA_MODE13_WIDTH) d[col] = t[d[col]];
+        }
+    }
+}
+
+void draw_string_blend(const char* s, int x, int y, uint8_t color) {
+    while (*s) {
+        draw_char_blend(*s++, x, y, color);
+        x += 8;
+    }
+}
+
+/* --- Lines ---
+ * Segments are clipped to the screen with Cohen-Sutherland first, so the
+ * rasterizer never tests bounds and off-screen parts cost nothing.
+ * Horizontal lines become one fill_span, vertical lines a column walk.
+ * Everything else steps a framebuffer pointer with Bresenham.
+ */
+#define CLIP_LEFT   1
+#define CLIP_RIGHT  2
+#define CLIP_TOP    4
+#define CLIP_BOTTOM 8
+
+struct point {
+    int x, y;
+};
+
+static inline int line_outcode(int x, int y) {
+    int code = 0;
+    if (x < 0) code |= CLIP_LEFT;
+    else if (x >= VGA_MODE13_WIDTH) code |= CLIP_RIGHT;
+    if (y < 0) code |= CLIP_TOP;
+    else if (y >= VGA_MODE13_HEIGHT) code |= CLIP_BOTTOM;
+    return code;
+}
+
+/* Clips the segment in place; returns 0 if nothing of it is on screen */
+int clip_line(int* x0, int* y0, int* x1, int* y1, int code0, int code1) {
+    while (1) {
+        if (!(code0 | code1)) return 1;
+        if (code0 & code1) return 0;
+
+        int code = code0 ? code0 : code1;
+        int x, y;
+        int64_t dx = *x1 - *x0;
+        int64_t dy = *y1 - *y0;
+        if (code & CLIP_BOTTOM) {
+            y = VGA_MODE13_HEIGHT - 1;
+            x = *x0 + (int)(dx * (y - *y0) / dy);
+        } else if (code & CLIP_TOP) {
+            y = 0;
+            x = *x0 + (int)(dx * (y - *y0) / dy);
+        } else if (code & CLIP_RIGHT) {
+            x = VGA_MODE13_WIDTH - 1;
+            y = *y0 + (int)(dy * (x - *x0) / dx);
+        } else {
+            x = 0;
+            y = *y0 + (int)(dy * (x - *x0) / dx);
+        }
+
+        if (code == code0) {
+            *x0 = x; *y0 = y;
+            code0 = line_outcode(x, y);
+        } else {
+            *x1 = x; *y1 = y;
+            code1 = line_outcode(x, y);
+        }
+    }
+}
+
+/* Draws an already clipped segment */
+static void raster_line(int x0, int y0, int x1, int y1, uint8_t color) {
+    if (y0 == y1) {
+        if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+        raster->fill_span(VGA_MODE13_ADDR + y0 * VGA_MODE13_WIDTH + x0, color, x1 - x0 + 1);
+        return;
+    }
+
+    if (y0 > y1) {
+        int t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+    uint8_t* p = VGA_MODE13_ADDR + y0 * VGA_MODE13_WIDTH + x0;
+    int dy = y1 - y0;
+
+    if (x0 == x1) {
+        for (int i = 0; i <= dy; i++, p += VGA_MODE13_WIDTH) *p = color;
+        return;
+    }
+
+    int dx = ABS(x1 - x0);
+    int sx = x0 < x1 ? 1 : -1;
+    if (dx >= dy) {
+        int err = dx / 2;
+        for (int i = 0; i <= dx; i++) {
+            *p = color;
+            p += sx;
+            err -= dy;
+            if (err < 0) { err += dx; p += VGA_MODE13_WIDTH; }
+        }
+    } else {
+        int err = dy / 2;
+        for (int i = 0; i <= dy; i++) {
+            *p = color;
+            p += VGA_MODE13_WIDTH;
+            err -= dx;
+            if (err < 0) { err += dy; p += sx; }
+        }
+    }
+}
+
+void draw_line(int x0, int y0, int x1, int y1, uint8_t color) {
+    if (clip_line(&x0, &y0, &x1, &y1, line_outcode(x0, y0), line_outcode(x1, y1))) {
+        raster_line(x0, y0, x1, y1, color);
+    }
+}
+
+/* Draws n - 1 connected segments; each vertex's outcode is computed once */
+void draw_polyline(const struct point* points, int n, uint8_t color) {
+    if (n < 2) return;
+    int code0 = line_outcode(points[0].x, points[0].y);
+    for (int i = 1; i < n; i++) {
+        int code1 = line_outcode(points[i].x, points[i].y);
+        if (!(code0 & code1)) {
+            int x0 = points[i - 1].x, y0 = points[i - 1].y;
+            int x1 = points[i].x, y1 = points[i].y;
+            if (clip_line(&x0, &y0, &x1, &y1, code0, code1)) {
+                raster_line(x0, y0, x1, y1, color);
+            }
+        }
+        code0 = code1;
+    }
+}
+
+/* Draws n independent segments from 2n points */
+void draw_lines(const struct point* points, int n, uint8_t color) {
+    for (int i = 0; i < n; i++, points += 2) {
+        int x0 = points[0].x, y0 = points[0].y;
+        int x1 = points[1].x, y1 = points[1].y;
+        int code0 = line_outcode(x0, y0);
+        int code1 = line_outcode(x1, y1);
+        if (code0 & code1) continue;
+        if (clip_line(&x0, &y0, &x1, &y1, code0, code1)) {
+            raster_line(x0, y0, x1, y1, color);
+        }
+    }
+}
+
+void fill_flat_bottom_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
+    int invslope1 = (x1 - x0) * 1000 / (y1 - y0);
+    int invslope2 = (x2 - x0) * 1000 / (y2 - y0);
+
+    int curx1 = x0 * 1000;
+    int curx2 = x0 * 1000;
+
+    for (int y = y0; y <= y1; y++) {
+        int x_start = curx1 / 1000;
+        int x_end   = curx2 / 1000;
+        if (x_start > x_end) {
+            int t = x_start; x_start = x_end; x_end = t;
+        }
+        draw_hspan(x_start, x_end, y, color);
+        curx1 += invslope1;
+        curx2 += invslope2;
+    }
+}
+
+void fill_flat_top_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
+    int invslope1 = (x2 - x0) * 1000 / (y2 - y0);
+    int invslope2 = (x2 - x1) * 1000 / (y2 - y1);
+
+    int curx1 = x2 * 1000;
+    int curx2 = x2 * 1000;
+
+    for (int y = y2; y >= y0; y--) {
+        int x_start = curx1 / 1000;
+        int x_end   = curx2 / 1000;
+        if (x_start > x_end) {
+            int t = x_start; x_start = x_end; x_end = t;
+        }
+        draw_hspan(x_start, x_end, y, color);
+        curx1 -= invslope1;
+        curx2 -= invslope2;
+    }
+}
+
+void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {
+    sort_vertices(&x0, &y0, &x1, &y1, &x2, &y2);
+
+    if (y0 == y2) {
+        int xmin = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+        int xmax = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+        draw_hspan(xmin, xmax, y0, color);
+    } else if (y1 == y2) {
+        fill_flat_bottom_triangle(x0, y0, x1, y1, x2, y2, color);
+    } else if (y0 == y1) {
+        fill_flat_top_triangle(x0, y0, x1, y1, x2, y2, color);
+    } else {
+        int x3 = x0 + ((y1 - y0) * (x2 - x0)) / (y2 - y0);
+        int y3 = y1;
+        fill_flat_bottom_triangle(x0, y0, x1, y1, x3, y3, color);
+        fill_flat_top_triangle(x1, y1, x3, y3, x2, y2, color);
+    }
+}
+
+/* --- Polygons ---
+ * fill_polygon rasterizes any simple or self-intersecting polygon in one
+ * top-to-bottom pass. Edges go into an edge table sorted by top scanline.
+ * An active edge list holds the edges crossing the current scanline, kept
+ * sorted by x with insertion sort (the order rarely changes between rows).
+ * Pixels are sampled at their centers, so polygons sharing an edge never
+ * overdraw each other.
+ */
+#define POLY_MAX_EDGES 256
+
+enum fill_rule {
+    FILL_EVEN_ODD,
+    FILL_NONZERO,
+};
+
+struct poly_edge {
+    int32_t x;     // 16.16 x at the center of the current scanline
+    int32_t slope; // 16.16 x step per scanline
+    int ytop, ybottom; // covers scanlines ytop <= y < ybottom
+    int winding;
+};
+
+static struct poly_edge poly_edges[POLY_MAX_EDGES];
+static struct poly_edge* poly_active[POLY_MAX_EDGES];
+
+/* Fills [xl, xr) given in 16.16, sampling pixel centers */
+static inline void poly_span(int32_t xl, int32_t xr, int y, uint8_t color) {
+    int x0 = (xl + 0x7FFF) >> 16;
+    int x1 = ((xr + 0x7FFF) >> 16) - 1;
+    draw_hspan(x0, x1, y, color);
+}
+
+void fill_polygon_rule(const struct point* points, int n, uint8_t color, enum fill_rule rule) {
+    if (n < 3) return;
+    if (n > POLY_MAX_EDGES) {
+        // dropping vertices would close the outline on the wrong edge
+        serial_print("fill_polygon: too many vertices, not drawn\n");
+        return;
+    }
+
+    // Edge table, insertion-sorted by ytop
+    int edge_count = 0;
+    int ymin = VGA_MODE13_HEIGHT, ymax = 0;
+    for (int i = 0; i < n; i++) {
+        const struct point* a = &points[i];
+        const struct point* b = &points[i + 1 < n ? i + 1 : 0];
+        if (a->y == b->y) continue;
+
+        int winding = 1;
+        if (a->y > b->y) {
+            const struct point* t = a; a = b; b = t;
+            winding = -1;
+        }
+        if (b->y <= 0 || a->y >= VGA_MODE13_HEIGHT) continue;
+
+        struct poly_edge e;
+        e.slope = (int32_t)(((int64_t)(b->x - a->x) << 16) / (b->y - a->y));
+        e.ytop = a->y;
+        e.ybottom = b->y;
+        e.winding = winding;
+        e.x = (a->x << 16) + e.slope / 2;
+        if (e.ytop < 0) {
+            e.x += (int32_t)((int64_t)e.slope * -e.ytop);
+            e.ytop = 0;
+        }
+        if (e.ybottom > VGA_MODE13_HEIGHT) e.ybottom = VGA_MODE13_HEIGHT;
+        if (e.ytop < ymin) ymin = e.ytop;
+        if (e.ybottom > ymax) ymax = e.ybottom;
+
+        int j = edge_count++;
+        while (j > 0 && poly_edges[j - 1].ytop > e.ytop) {
+            poly_edges[j] = poly_edges[j - 1];
+            j--;
+        }
+        poly_edges[j] = e;
+    }
+
+    int next_edge = 0;
+    int active_count = 0;
+    for (int y = ymin; y < ymax; y++) {
+        // Retire finished edges, then activate edges starting on this row
+        int kept = 0;
+        for (int i = 0; i < active_count; i++) {
+            if (poly_active[i]->ybottom > y) poly_active[kept++] = poly_active[i];
+        }
+        active_count = kept;
+        while (next_edge < edge_count && poly_edges[next_edge].ytop == y) {
+            poly_active[active_count++] = &poly_edges[next_edge++];
+        }
+
+        for (int i = 1; i < active_count; i++) {
+            struct poly_edge* e = poly_active[i];
+            int j = i;
+            while (j > 0 && poly_active[j - 1]->x > e->x) {
+                poly_active[j] = poly_active[j - 1];
+                j--;
+            }
+            poly_active[j] = e;
+        }
+
+        if (rule == FILL_EVEN_ODD) {
+            for (int i = 0; i + 1 < active_count; i += 2) {
+                poly_span(poly_active[i]->x, poly_active[i + 1]->x, y, color);
+            }
+        } else {
+            int winding = 0;
+            for (int i = 0; i + 1 < active_count; i++) {
+                winding += poly_active[i]->winding;
+                if (winding) poly_span(poly_active[i]->x, poly_active[i + 1]->x, y, color);
+            }
+        }
+
+        for (int i = 0; i < active_count; i++) {
+            poly_active[i]->x += poly_active[i]->slope;
+        }
+    }
+}
+
+void fill_polygon(const struct point* points, int n, uint8_t color) {
+    fill_polygon_rule(points, n, color, FILL_EVEN_ODD);
+}
+
+/*
+ * Ellipse and circle fills walk the rows outward from the center, shrinking
+ * the half-width incrementally: lhs tracks w^2 b^2 + dy^2 a^2 with additions
+ * only, and each row is drawn exactly once as a span.
+ */
+void fill_ellipse(int cx, int cy, int a, int b, uint8_t color) {
+    if (a < 0 || b < 0) return;
+    int64_t aa = (int64_t)a * a, bb = (int64_t)b * b;
+    int64_t limit = aa * bb + (int64_t)a * b;
+    int64_t lhs = aa * bb; // w = a, dy = 0
+    int w = a;
+
+    for (int dy = 0; dy <= b; dy++) {
+        while (w > 0 && lhs > limit) {
+            lhs -= (2 * (int64_t)w - 1) * bb;
+            w--;
+        }
+        if (lhs > limit) break;
+        draw_hspan(cx - w, cx + w, cy + dy, color);
+        if (dy) draw_hspan(cx - w, cx + w, cy - dy, color);
+        lhs += (2 * (int64_t)dy + 1) * aa;
+    }
+}
+
+void fill_circle(int cx, int cy, int r, uint8_t color) {
+    fill_ellipse(cx, cy, r, r, color);
+}
+
+/* --- Sprites ---
+ * Sprites are 8bpp images stored as runs. The encoded block starts with a
+ * 32-bit offset per row, so clipping at the top skips rows directly. Each
+ * row is a 16-bit run count followed by runs of
+ *     u16 skip (transparent pixels), u16 len, len opaque pixel bytes.
+ * Transparent pixels are never touched and cost one addition per run.
+ * Opaque runs are clipped at run granularity and copied as a block.
+ */
+struct sprite {
+    int width, height;
+    const uint32_t* row_offsets;
+    const uint8_t* data;
+};
+
+struct rect {
+    int x0, y0, x1, y1; // x1/y1 exclusive
+};
+
+static const struct rect screen_rect = { 0, 0, VGA_MODE13_WIDTH, VGA_MODE13_HEIGHT };
+
+static inline uint16_t sprite_read16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline void sprite_write16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/*
+ * Encodes a raw w*h 8bpp image, treating pixels equal to key as transparent.
+ * Writes at most cap bytes to out (4-byte aligned) and fills in spr, which
+ * points into out.
+ * Returns the encoded size, or -1 if out is too small.
+ */
+int sprite_encode(const uint8_t* pixels, int w, int h, uint8_t key, uint8_t* out, int cap, struct sprite* spr) {
+    int pos = h * sizeof(uint32_t);
+    if (w <= 0 || h <= 0 || w > 0xFFFF || pos > cap) return -1;
+    uint32_t* offsets = (uint32_t*)out;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = pixels + y * w;
+        offsets[y] = pos;
+        int count_pos = pos;
+        int runs = 0;
+        pos += 2;
+
+        int x = 0;
+        while (x < w) {
+            int start = x;
+            while (x < w && row[x] == key) x++;
+            if (x == w) break;
+            int skip = x - start;
+            start = x;
+            while (x < w && row[x] != key) x++;
+            int len = x - start;
+
+            if (pos + 4 + len > cap) return -1;
+            sprite_write16(out + pos, skip);
+            sprite_write16(out + pos + 2, len);
+            memcpy(out + pos + 4, row + start, len);
+            pos += 4 + len;
+            runs++;
+        }
+        if (count_pos + 2 > cap) return -1;
+        sprite_write16(out + count_pos, runs);
+    }
+
+    spr->width = w;
+    spr->height = h;
+    spr->row_offsets = offsets;
+    spr->data = out;
+    return pos;
+}
+
+#define SPRITE_COPY  0
+#define SPRITE_SOLID 1 // opaque pixels filled with one color (silhouettes, erasing)
+#define SPRITE_BLEND 2 // opaque pixels mixed half into the screen
+#define SPRITE_SHADE 3 // screen under opaque pixels darkened to a shade level (drop shadows)
+
+/*
+ * Walks the visible runs of spr drawn at (x, y) within clip and writes them
+ * in one of the modes above; arg is the color for SPRITE_SOLID and the level
+ * for SPRITE_SHADE.
+ */
+static void sprite_draw(const struct sprite* spr, int x, int y, const struct rect* clip, int mode, uint8_t arg) {
+    int row0 = clip->y0 > y ? clip->y0 - y : 0;
+    int row1 = clip->y1 - y < spr->height ? clip->y1 - y : spr->height;
+    if (x >= clip->x1 || x + spr->width <= clip->x0) return;
+
+    uint8_t* line = VGA_MODE13_ADDR + (y + row0) * VGA_MODE13_WIDTH;
+    for (int row = row0; row < row1; row++, line += VGA_MODE13_WIDTH) {
+        const uint8_t* p = spr->data + spr->row_offsets[row];
+        int runs = sprite_read16(p);
+        p += 2;
+
+        int sx = x;
+        while (runs--) {
+            sx += sprite_read16(p);
+            int len = sprite_read16(p + 2);
+            const uint8_t* src = p + 4;
+            p += 4 + len;
+
+            if (sx >= clip->x1) break;
+            int start = sx, end = sx + len;
+            sx = end;
+            if (end <= clip->x0) continue;
+            if (start < clip->x0) { src += clip->x0 - start; start = clip->x0; }
+            if (end > clip->x1) end = clip->x1;
+
+            if (mode == SPRITE_COPY) {
+                memcpy(line + start, src, end - start);
+            } else if (mode == SPRITE_SOLID) {
+                raster->fill_span(line + start, arg, end - start);
+            } else if (mode == SPRITE_SHADE) {
+                blend_span(line + start, shade_for(arg), end - start);
+            } else {
+                for (int i = 0; i < end - start; i++) line[start + i] = blend_table[src[i]][line[start + i]];
+            }
+        }
+    }
+}
+
+void sprite_blit_clipped(const struct sprite* spr, int x, int y, const struct rect* clip) {
+    sprite_draw(spr, x, y, clip, SPRITE_COPY, 0);
+}
+
+void sprite_blit(const struct sprite* spr, int x, int y) {
+    sprite_draw(spr, x, y, &screen_rect, SPRITE_COPY, 0);
+}
+
+/* Fills the sprite's opaque pixels with one color */
+void sprite_blit_solid(const struct sprite* spr, int x, int y, uint8_t color) {
+    sprite_draw(spr, x, y, &screen_rect, SPRITE_SOLID, color);
+}
+
+void sprite_blit_blend(const struct sprite* spr, int x, int y) {
+    blend_update();
+    sprite_draw(spr, x, y, &screen_rect, SPRITE_BLEND, 0);
+}
+
+/* Darkens what is under the sprite's opaque pixels, for drop shadows */
+void sprite_blit_shade(const struct sprite* spr, int x, int y, int level) {
+    blend_update();
+    sprite_draw(spr, x, y, &screen_rect, SPRITE_SHADE, level);
+}
+
+/* --- Mouse cursor ---
+ * '#' is the cursor body, 'o' its outline; the art's top-left corner sits
+ * at (mouse_x - 1, mouse_y + 1).
+ */
+#define CURSOR_WIDTH   9
+#define CURSOR_HEIGHT  13
+#define CURSOR_COLOR   0x3F
+#define CURSOR_OUTLINE 0x00
+#define CURSOR_KEY     0xFF
+
+static const char cursor_art[CURSOR_HEIGHT][CURSOR_WIDTH + 1] = {
+    "oo       ",
+    "o#o      ",
+    "o##o     ",
+    "o###o    ",
+    "o####o   ",
+    "o#####o  ",
+    "o######o ",
+    "o#######o",
+    "o#####oo ",
+    "o#oo###o ",
+    "oo  o###o",
+    "     o##o",
+    "      oo ",
+};
+
+static struct sprite cursor_sprite;
+static uint8_t cursor_sprite_data[CURSOR_HEIGHT * (sizeof(uint32_t) + 2 + 3 * 4 + CURSOR_WIDTH)] __attribute__((aligned(4)));
+
+void cursor_init() {
+    uint8_t pixels[CURSOR_WIDTH * CURSOR_HEIGHT];
+    for (int y = 0; y < CURSOR_HEIGHT; y++) {
+        for (int x = 0; x < CURSOR_WIDTH; x++) {
+            char c = cursor_art[y][x];
+            pixels[y * CURSOR_WIDTH + x] = c == '#' ? CURSOR_COLOR : c == 'o' ? CURSOR_OUTLINE : CURSOR_KEY;
+        }
+    }
+    sprite_encode(pixels, CURSOR_WIDTH, CURSOR_HEIGHT, CURSOR_KEY, cursor_sprite_data, sizeof(cursor_sprite_data), &cursor_sprite);
+}
+
+void draw_mouse_cursor(int x, int y) {
+    sprite_blit(&cursor_sprite, x - 1, y + 1);
+}
+
+void erase_mouse_cursor(int x, int y) {
+    sprite_blit_solid(&cursor_sprite, x - 1, y + 1, 0);
+}
+
+/* --- Mouse packets ---
+ * input_poll drains every pending byte and assembles packets, resyncing on
+ * byte 0 (bit 3 is always set there) and on a partial packet left stale for
+ * MOUSE_RESYNC_MS. Motion only accumulates; mouse_apply moves the cursor once
+ * per frame, so drawing cost does not depend on the packet rate.
+ */
+#define MOUSE_SAMPLE_RATE 100
+#define MOUSE_RESYNC_MS   20
+#define MOUSE_POLL_MAX    64 // bytes per poll, so a flood cannot starve the frame
+
+struct mouse_motion {
+    int dx, dy;         // screen direction, y grows downwards
+    int wheel;          // positive = towards the user
+    uint8_t buttons;    // bit 0 left, 1 right, 2 middle
+    uint32_t packets;
+    uint32_t resyncs;   // bytes dropped to find a packet start again
+    uint32_t overflows; // packets dropped for X/Y overflow
+};
+
+int mouse_x = VGA_MODE13_WIDTH / 2;
+int mouse_y = VGA_MODE13_HEIGHT / 2;
+static int mouse_packet_size = 3;
+static struct mouse_motion mouse_motion;
+
+static uint8_t mouse_packet_bytes[4];
+
+/* Adds a byte to the packet being assembled; returns 1 once mouse_packet_bytes holds a whole one */
+static int mouse_feed(uint8_t b) {
+    static int cycle = 0;
+    static uint64_t last_byte = 0;
+
+    uint64_t now = rdtsc();
+    if (cycle > 0 && now - last_byte > tsc_per_ms * MOUSE_RESYNC_MS) {
+        mouse_motion.resyncs += cycle;
+        cycle = 0;
+    }
+    last_byte = now;
+
+    if (cycle == 0 && !(b & 0x08)) {
+        mouse_motion.resyncs++;
+        return 0;
+    }
+    mouse_packet_bytes[cycle++] = b;
+    if (cycle < mouse_packet_size) return 0;
+    cycle = 0;
+    return 1;
+}
+
+void mouse_packet(const uint8_t* packet) {
+    mouse_motion.packets++;
+    mouse_motion.buttons = packet[0] & 0x07;
+    if (packet[0] & 0xC0) {
+        mouse_motion.overflows++;
+        return;
+    }
+    // 9-bit two's complement, sign bits in byte 0
+    mouse_motion.dx += (int)packet[1] - ((packet[0] << 4) & 0x100);
+    mouse_motion.dy -= (int)packet[2] - ((packet[0] << 3) & 0x100);
+    if (mouse_packet_size == 4) {
+        mouse_motion.wheel += (int8_t)(packet[3] << 4) >> 4;
+    }
+}
+
+/* Applies the motion gathered since the last frame; returns 1 if the cursor moved */
+int mouse_apply() {
+    if (!mouse_motion.dx && !mouse_motion.dy) return 0;
+
+    mouse_x += mouse_motion.dx;
+    mouse_y += mouse_motion.dy;
+    mouse_motion.dx = mouse_motion.dy = 0;
+
+    if (mouse_x < 0) mouse_x = 0;
+    if (mouse_x >= VGA_MODE13_WIDTH) mouse_x = VGA_MODE13_WIDTH - 1;
+    if (mouse_y < 0) mouse_y = 0;
+    if (mouse_y >= VGA_MODE13_HEIGHT) mouse_y = VGA_MODE13_HEIGHT - 1;
+    return 1;
+}
+
+/* --- Input latency ---
+ * Input is stamped with the TSC when input_poll reads it. The frame that
+ * first shows it (a typed key echoed above the bottom bar, the cursor
+ * moving) hands the stamp to latency_reflect, and latency_present turns the
+ * stamps into samples once the frame is up: at the start of the next
+ * vertical retrace, after which scanout shows what was drawn. palette_flush
+ * has usually just waited for it; when the palette was clean, latency_present
+ * waits itself. Samples go into one histogram per source, printed by the
+ * "latency" console command.
+ */
+#define LATENCY_BUCKET_US 250
+#define LATENCY_BUCKETS   256 // 64 ms; the last bucket takes everything slower
+#define LATENCY_PENDING   64  // stamps waiting for one frame
+#define LATENCY_BAR_MAX   40
+
+struct latency_histogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+};
+
+static struct latency_histogram latency_keys;
+static struct latency_histogram latency_mouse;
+
+static struct latency_histogram* latency_pending_histogram[LATENCY_PENDING];
+static uint64_t latency_pending_tsc[LATENCY_PENDING];
+static int latency_pending_count = 0;
+
+// Motion packets not yet drawn; the oldest are kept when it fills up
+static uint64_t latency_mouse_tsc[LATENCY_PENDING];
+static int latency_mouse_count = 0;
+
+/* Notes that the frame being drawn shows input received at tsc */
+void latency_reflect(struct latency_histogram* h, uint64_t tsc) {
+    if (latency_pending_count >= LATENCY_PENDING) return;
+    latency_pending_histogram[latency_pending_count] = h;
+    latency_pending_tsc[latency_pending_count++] = tsc;
+}
+
+void latency_mouse_received(uint64_t tsc) {
+    if (latency_mouse_count < LATENCY_PENDING) latency_mouse_tsc[latency_mouse_count++] = tsc;
+}
+
+/* Hands the stamps of the motion mouse_apply consumed to the frame, or drops them if the cursor stayed put */
+void latency_mouse_applied(int moved) {
+    for (int i = 0; moved && i < latency_mouse_count; i++) latency_reflect(&latency_mouse, latency_mouse_tsc[i]);
+    latency_mouse_count = 0;
+}
+
+/* Called after the frame is drawn; retraced says palette_flush already waited for vblank */
+void latency_present(int retraced) {
+    if (latency_pending_count == 0) return;
+    if (!retraced) vga_wait_vblank();
+    uint64_t now = rdtsc();
+    for (int i = 0; i < latency_pending_count; i++) {
+        struct latency_histogram* h = latency_pending_histogram[i];
+        uint32_t us = (uint32_t)((now - latency_pending_tsc[i]) * 1000 / tsc_per_ms);
+        uint32_t bucket = us / LATENCY_BUCKET_US;
+        h->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+        h->count++;
+        if (us > h->max_us) h->max_us = us;
+    }
+    latency_pending_count = 0;
+}
+
+// Upper edge in microseconds of the bucket holding the sample of the given rank
+static uint32_t latency_percentile(const struct latency_histogram* h, uint32_t percent) {
+    uint32_t rank = (h->count * percent + 99) / 100, seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) return (i + 1) * LATENCY_BUCKET_US;
+    }
+    return h->max_us;
+}
+
+static void latency_print_ms(uint32_t us) {
+    serial_print_centi(us / 10);
+    serial_print(" ms");
+}
+
+void latency_print(const char* name, const struct latency_histogram* h) {
+    serial_print("LATENCY ");
+    serial_print(name);
+    serial_print(": ");
+    serial_print_dec(h->count);
+    if (h->count == 0) {
+        serial_print(" samples\n");
+        return;
+    }
+    serial_print(" samples, p50 ");
+    latency_print_ms(latency_percentile(h, 50));
+    serial_print(", p99 ");
+    latency_print_ms(latency_percentile(h, 99));
+    serial_print(", max ");
+    latency_print_ms(h->max_us);
+    serial_print("\n");
+
+    uint32_t peak = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (h->buckets[i] > peak) peak = h->buckets[i];
+    }
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (!h->buckets[i]) continue;
+        serial_print("  ");
+        latency_print_ms(i * LATENCY_BUCKET_US);
+        if (i < LATENCY_BUCKETS - 1) {
+            serial_print(" - ");
+            latency_print_ms((i + 1) * LATENCY_BUCKET_US);
+        } else {
+            serial_print(" and up");
+        }
+        serial_print("  ");
+        serial_print_dec(h->buckets[i]);
+        serial_print(" ");
+        for (uint32_t n = (h->buckets[i] * LATENCY_BAR_MAX + peak - 1) / peak; n; n--) serial_write_char('#');
+        serial_print("\n");
+    }
+}
+
+void latency_reset() {
+    memset(latency_keys.buckets, 0, sizeof(latency_keys.buckets));
+    memset(latency_mouse.buckets, 0, sizeof(latency_mouse.buckets));
+    latency_keys.count = latency_mouse.count = 0;
+    latency_keys.max_us = latency_mouse.max_us = 0;
+}
+
+/* --- Input record/replay ---
+ * All PS/2 input goes through input_poll: mouse packets and keyboard
+ * scancodes, stamped with the frame that consumes them. While recording they
+ * are also logged to input_events. A replay feeds the log back instead of
+ * reading the controller, each event at the start of the frame it was
+ * recorded in, and renders frames back to back, so two replays of one
+ * recording do the same work frame for frame. Replays print the cycles each
+ * frame took to draw (palette upload and vblank wait excluded) for
+ * tools/inputrec.py to compare.
+ *
+ * A recording dumped with "record dump" can come back as a Multiboot module
+ * (tools/inputrec.py pack), which replays from the first frame after boot:
+ *
+ *   "MTIR"  frames (u32 LE)  count (u32 LE)
+ *   count * { frame (u32 LE)  source (u8)  length (u8)  data[4] }
+ */
+#define INPUT_MAX_EVENTS   8192
+#define INPUT_EVENT_BYTES  10 // in a recording module
+#define INPUT_KEYBOARD     'k'
+#define INPUT_MOUSE        'm'
+#define REPLAY_MAX_FRAMES  4096
+#define KEY_QUEUE_SIZE     32 // power of two
+
+struct input_event {
+    uint32_t frame; // relative to the start of the recording
+    uint8_t source;
+    uint8_t length;
+    uint8_t data[4];
+};
+
+#define INPUT_IDLE      0
+#define INPUT_RECORDING 1
+#define INPUT_REPLAYING 2
+
+static struct input_event input_events[INPUT_MAX_EVENTS];
+static uint32_t input_event_count = 0;
+static uint32_t input_recorded_frames = 0;
+static uint32_t input_dropped = 0;
+static int input_mode = INPUT_IDLE;
+static uint32_t input_frame = 0;       // frames drawn since boot
+static uint32_t input_start_frame = 0; // input_frame when recording/replay began
+static uint32_t input_next_event = 0;
+static uint32_t replay_cycles[REPLAY_MAX_FRAMES];
+
+struct key_event {
+    char c;
+    uint64_t received; // TSC at input_poll, 0 for replayed keys
+};
+
+static struct key_event key_queue[KEY_QUEUE_SIZE];
+static uint32_t key_head = 0, key_tail = 0;
+
+#define TYPED_MAX 32 // characters echoed on the line above the bottom bar
+
+// Scene state a recording's first frame depends on
+int boxi = -20;
+int box_direction = 1;
+int scene_angle = 0;
+static char typed_text[TYPED_MAX + 1];
+static int typed_len = 0;
+static int scene_refresh = 1; // the static layer must be redrawn next frame
+
+/* Echoes a key above the bottom bar: Enter clears it, Backspace deletes, the oldest character scrolls off */
+void typed_add(char c) {
+    if (c == '\n') {
+        typed_len = 0;
+    } else if (c == '\b') {
+        if (typed_len) typed_len--;
+    } else if (c >= ' ' && c <= '~') {
+        if (typed_len == TYPED_MAX) memmove(typed_text, typed_text + 1, --typed_len);
+        typed_text[typed_len++] = c;
+    }
+    typed_text[typed_len] = '\0';
+}
+
+static void key_push(char c, uint64_t received) {
+    if (key_head - key_tail >= KEY_QUEUE_SIZE) return;
+    struct key_event* k = &key_queue[key_head++ & (KEY_QUEUE_SIZE - 1)];
+    k->c = c;
+    k->received = received;
+}
+
+/* Next key typed, or 0; *received gets its input_poll stamp */
+char key_pop(uint64_t* received) {
+    if (key_head == key_tail) return 0;
+    const struct key_event* k = &key_queue[key_tail++ & (KEY_QUEUE_SIZE - 1)];
+    *received = k->received;
+    return k->c;
+}
+
+/* Puts the scene and input state back to how they are at boot */
+static void input_reset_scene() {
+    boxi = -20;
+    box_direction = 1;
+    scene_angle = 0;
+    mouse_x = VGA_MODE13_WIDTH / 2;
+    mouse_y = VGA_MODE13_HEIGHT / 2;
+    memset(&mouse_motion, 0, sizeof(mouse_motion));
+    shift_pressed = 0;
+    key_head = key_tail = 0;
+    typed_len = 0;
+    typed_text[0] = '\0';
+    latency_mouse_count = 0;
+    scene_refresh = 1;
+}
+
+static void input_record(uint8_t source, const uint8_t* data, int length) {
+    if (input_mode != INPUT_RECORDING) return;
+    if (input_event_count >= INPUT_MAX_EVENTS) {
+        input_dropped++;
+        return;
+    }
+    struct input_event* e = &input_events[input_event_count++];
+    e->frame = input_frame - input_start_frame;
+    e->source = source;
+    e->length = length;
+    memcpy(e->data, data, length);
+}
+
+static void input_apply(const struct input_event* e) {
+    if (e->source == INPUT_MOUSE) {
+        mouse_packet(e->data);
+    } else {
+        char c = keyboard_scancode(e->data[0]);
+        if (c) key_push(c, 0);
+    }
+}
+
+/* Reads whatever the PS/2 controller has, unless a replay stands in for it */
+void input_poll() {
+    if (input_mode == INPUT_REPLAYING) return;
+
+    for (int i = 0; i < MOUSE_POLL_MAX; i++) {
+        uint8_t status = inb(PS2_STATUS);
+        if (!(status & 0x01)) return;
+        uint8_t b = inb(PS2_DATA);
+        uint64_t now = rdtsc();
+
+        if (status & 0x20) {
+            if (!mouse_feed(b)) continue;
+            input_record(INPUT_MOUSE, mouse_packet_bytes, mouse_packet_size);
+            mouse_packet(mouse_packet_bytes);
+            if (mouse_packet_bytes[1] || mouse_packet_bytes[2]) latency_mouse_received(now);
+        } else {
+            input_record(INPUT_KEYBOARD, &b, 1);
+            char c = keyboard_scancode(b);
+            if (c) key_push(c, now);
+        }
+    }
+}
+
+void input_record_start() {
+    input_reset_scene();
+    input_event_count = 0;
+    input_recorded_frames = 0;
+    input_dropped = 0;
+    input_start_frame = input_frame;
+    input_mode = INPUT_RECORDING;
+}
+
+void input_record_stop() {
+    if (input_mode != INPUT_RECORDING) return;
+    input_recorded_frames = input_frame - input_start_frame;
+    input_mode = INPUT_IDLE;
+}
+
+/* Starts replaying the recording in input_events; returns -1 if there is none */
+int input_replay_start() {
+    if (input_mode == INPUT_RECORDING) input_record_stop();
+    if (input_recorded_frames == 0) return -1;
+    input_reset_scene();
+    input_next_event = 0;
+    input_start_frame = input_frame;
+    input_mode = INPUT_REPLAYING;
+    return 0;
+}
+
+/* Loads a recording module and arms a replay; returns 0 on success */
+int input_load(const uint8_t* data, uint32_t size) {
+    if (size < 12 || memcmp(data, "MTIR", 4) != 0) return -1;
+    uint32_t frames = data[4] | data[5] << 8 | data[6] << 16 | (uint32_t)data[7] << 24;
+    uint32_t count = data[8] | data[9] << 8 | data[10] << 16 | (uint32_t)data[11] << 24;
+    if (count > INPUT_MAX_EVENTS || size < 12 + count * INPUT_EVENT_BYTES) return -1;
+
+    const uint8_t* p = data + 12;
+    for (uint32_t i = 0; i < count; i++, p += INPUT_EVENT_BYTES) {
+        struct input_event* e = &input_events[i];
+        e->frame = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        e->source = p[4];
+        e->length = p[5] > 4 ? 4 : p[5];
+        memcpy(e->data, p + 6, 4);
+    }
+    input_event_count = count;
+    input_recorded_frames = frames;
+    input_mode = INPUT_IDLE;
+    return input_replay_start();
+}
+
+/* Feeds the events recorded for the frame about to be drawn */
+void input_frame_begin() {
+    if (input_mode != INPUT_REPLAYING) return;
+    uint32_t frame = input_frame - input_start_frame;
+    while (input_next_event < input_event_count && input_events[input_next_event].frame <= frame) {
+        input_apply(&input_events[input_next_event++]);
+    }
+}
+
+static void replay_report(uint32_t frames) {
+    uint64_t total = 0;
+    uint32_t min = 0xFFFFFFFF, max = 0;
+    uint32_t kept = frames < REPLAY_MAX_FRAMES ? frames : REPLAY_MAX_FRAMES;
+
+    for (uint32_t i = 0; i < kept; i++) {
+        total += replay_cycles[i];
+        if (replay_cycles[i] < min) min = replay_cycles[i];
+        if (replay_cycles[i] > max) max = replay_cycles[i];
+    }
+    serial_print("REPLAY frames ");
+    serial_print_dec(kept);
+    serial_print(" events ");
+    serial_print_dec(input_event_count);
+    serial_print(" cycles mean ");
+    serial_print_dec(kept ? (uint32_t)(total / kept) : 0);
+    serial_print(" min ");
+    serial_print_dec(kept ? min : 0);
+    serial_print(" max ");
+    serial_print_dec(max);
+    serial_print("\n");
+    for (uint32_t i = 0; i < kept; i++) {
+        serial_print_dec(i);
+        serial_print(" ");
+        serial_print_dec(replay_cycles[i]);
+        serial_print("\n");
+    }
+    serial_print("REPLAY END\n");
+}
+
+/* Closes the frame just drawn, which took cycles to render */
+void input_frame_end(uint32_t cycles) {
+    input_frame++;
+    if (input_mode != INPUT_REPLAYING) return;
+
+    uint32_t frame = input_frame - input_start_frame; // frames done
+    if (frame <= REPLAY_MAX_FRAMES) replay_cycles[frame - 1] = cycles;
+    if (frame >= input_recorded_frames) {
+        input_mode = INPUT_IDLE;
+        scene_refresh = 1; // live frames start from a fresh static layer
+        replay_report(frame);
+    }
+}
+
+/* Replays draw frames back to back instead of at the frame rate */
+int input_replaying() {
+    return input_mode == INPUT_REPLAYING;
+}
+
+/* Writes the recording as text lines tools/inputrec.py turns back into a module */
+void input_dump() {
+    serial_print("RECORD frames ");
+    serial_print_dec(input_recorded_frames);
+    serial_print(" events ");
+    serial_print_dec(input_event_count);
+    serial_print(" dropped ");
+    serial_print_dec(input_dropped);
+    serial_print("\n");
+    for (uint32_t i = 0; i < input_event_count; i++) {
+        static const char hex[] = "0123456789abcdef";
+        const struct input_event* e = &input_events[i];
+        char line[16];
+        int n = 0;
+
+        serial_print_dec(e->frame);
+        line[n++] = ' ';
+        line[n++] = e->source;
+        line[n++] = ' ';
+        for (int k = 0; k < e->length; k++) {
+            line[n++] = hex[e->data[k] >> 4];
+            line[n++] = hex[e->data[k] & 15];
+        }
+        line[n++] = '\n';
+        serial_write(line, n);
+    }
+    serial_print("RECORD END\n");
+}
+
+#ifdef KERNEL_BENCH
+static uint8_t bench_src[65536] __attribute__((aligned(16)));
+static uint8_t bench_dst[65536] __attribute__((aligned(16)));
+
+void serial_print_gbps(uint64_t bytes, uint64_t cycles, uint64_t cpu_freq) {
+    if (cycles == 0) cycles = 1;
+    serial_print_centi(bytes * cpu_freq / cycles / 10000000ULL);
+    serial_print(" GB/s");
+}
+
+/* Reports memcpy bandwidth RAM->RAM and RAM->VRAM; clobbers the screen */
+void mem_benchmark(uint64_t cpu_freq) {
+    const int passes = 16;
+    const uint32_t screen_bytes = VGA_MODE13_WIDTH * VGA_MODE13_HEIGHT;
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < passes; i++) {
+        memcpy(bench_dst, bench_src, sizeof(bench_dst));
+    }
+    uint64_t ram_cycles = rdtsc() - start;
+
+    start = rdtsc();
+    for (int i = 0; i < passes; i++) {
+        memcpy(VGA_MODE13_ADDR, bench_src, screen_bytes);
+    }
+    uint64_t vram_cycles = rdtsc() - start;
+
+    serial_print("memcpy (");
+    serial_print(mem_impl_name);
+    serial_print("): RAM ");
+    serial_print_gbps((uint64_t)passes * sizeof(bench_dst), ram_cycles, cpu_freq);
+    serial_print(", VRAM ");
+    serial_print_gbps((uint64_t)passes * screen_bytes, vram_cycles, cpu_freq);
+    serial_print("\n");
+}
+
+#define DISK_BENCH_BLOCKS 1024 // 4 MiB
+
+/* Sequential read through the block cache, with DMA (if available) and then PIO */
+void disk_benchmark(uint64_t cpu_freq) {
+    uint32_t blocks = ata_sectors / ATA_BLOCK_SECTORS;
+    if (blocks > DISK_BENCH_BLOCKS) blocks = DISK_BENCH_BLOCKS;
+    int dma = ata_dma_enabled;
+
+    for (int pass = dma ? 0 : 1; pass < 2; pass++) {
+        ata_dma_enabled = pass == 0;
+        bcache_init();
+        uint32_t irqs = ata_irq_count;
+        uint32_t done = 0;
+
+        uint64_t start = rdtsc();
+        while (done < blocks && bcache_read(done)) done++;
+        uint64_t cycles = rdtsc() - start;
+        if (pass == 0) dma = ata_dma_enabled;
+
+        serial_print(pass == 0 ? "disk read (DMA): " : "disk read (PIO): ");
+        serial_print_dec(done * (ATA_BLOCK_SIZE / 1024));
+        serial_print(" KiB, ");
+        serial_print_dec((uint64_t)done * ATA_BLOCK_SIZE * cpu_freq / (cycles + 1) / 1000000);
+        serial_print(" MB/s, ");
+        serial_print_dec(bcache_stats.hits);
+        serial_print(" hits, ");
+        serial_print_dec(bcache_stats.misses);
+        serial_print(" misses, ");
+        serial_print_dec(bcache_stats.prefetched);
+        serial_print(" read ahead, ");
+        serial_print_dec(ata_irq_count - irqs);
+        serial_print(done < blocks ? " IRQs, READ ERROR\n" : " IRQs\n");
+    }
+    ata_dma_enabled = dma;
+    bcache_init();
+}
+
+#endif
+
+#ifdef KERNEL_BENCH
+/* Spins TRANSFORM_SHAPES triangles about their own centers, each with its own angle and scale */
+#define TRANSFORM_SHAPES 256
+
+void transform_benchmark(uint64_t cpu_freq) {
+    static const struct fix_vec2 model[3] = {
+        { 0, -6 * FIX_ONE }, { -5 * FIX_ONE, 3 * FIX_ONE }, { 5 * FIX_ONE, 3 * FIX_ONE },
+    };
+    static struct fix_point pts[TRANSFORM_SHAPES][3];
+    const int frames = 20;
+    uint64_t transform_cycles = 0, draw_cycles = 0;
+
+    for (int f = 0; f < frames; f++) {
+        uint64_t start = rdtsc();
+        for (int i = 0; i < TRANSFORM_SHAPES; i++) {
+            struct fix_transform t;
+            int32_t scale = FIX_ONE + fix_mul(fix_sin(i * 37 + f * 8), FIX_ONE / 2);
+            fix_transform_set(&t, f * 16 + i * 5, scale, fix_from_int(12 + (i % 16) * 19), fix_from_int(12 + (i / 16) * 11));
+            fix_transform_points(&t, model, pts[i], 3);
+        }
+        uint64_t mid = rdtsc();
+        for (int i = 0; i < TRANSFORM_SHAPES; i++) {
+            draw_triangle(pts[i][0].x, pts[i][0].y, pts[i][1].x, pts[i][1].y, pts[i][2].x, pts[i][2].y, (uint8_t)(32 + i % 72));
+        }
+        transform_cycles += mid - start;
+        draw_cycles += rdtsc() - mid;
+    }
 
-    int boxi = -20;
-    int direction = 1;
+    serial_print("transform: ");
+    serial_print_dec(TRANSFORM_SHAPES);
+    serial_print(" spinning triangles, ");
+    serial_print_centi(transform_cycles * 100 / ((uint64_t)frames * TRANSFORM_SHAPES * 3));
+    serial_print(" cycles/vertex, ");
+    serial_print_dec((transform_cycles + draw_cycles) / frames);
+    serial_print(" cycles/frame (");
+    serial_print_dec(cpu_freq / ((transform_cycles + draw_cycles) / frames + 1));
+    serial_print(" frames/s)\n");
+}
 
-    while (1) {
-        char c = keyboard_poll();
-        if (c) {
+/* Cycles per covered pixel of text at 1x to 4x, and of 4x drawn as a box per font pixel */
+void text_benchmark() {
+    static const char text[] = "The quick brown fox";
+    const int reps = 50;
+
+    serial_print("text: cycles/pixel");
+    for (int scale = 1; scale <= GLYPH_MAX_SCALE; scale++) {
+        int len = VGA_MODE13_WIDTH / (8 * scale); // as much as fits on one line
+        if (len > (int)sizeof(text) - 1) len = sizeof(text) - 1;
+        char line[sizeof(text)];
+        memcpy(line, text, len);
+        line[len] = '\0';
+
+        uint64_t start = rdtsc();
+        for (int r = 0; r < reps; r++) draw_string_scaled(line, 0, 0, scale, (uint8_t)(32 + r));
+        uint64_t pixels = (uint64_t)reps * len * 64 * scale * scale;
+        serial_print(scale == 1 ? " " : ", ");
+        serial_print_dec(scale);
+        serial_print("x ");
+        serial_print_centi((rdtsc() - start) * 100 / pixels);
+    }
+
+    const int len = VGA_MODE13_WIDTH / 32;
+    uint64_t start = rdtsc();
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < len; i++) {
+            const uint8_t* glyph = font8x8_basic[(uint8_t)text[i]];
+            for (int row = 0; row < 8; row++) {
+                for (int col = 0; col < 8; col++) {
+                    if ((glyph[row] >> col) & 1) draw_box(i * 32 + col * 4, row * 4, i * 32 + col * 4 + 3, row * 4 + 3, (uint8_t)(32 + r));
+                }
+            }
+        }
+    }
+    serial_print(", 4x as boxes ");
+    serial_print_centi((rdtsc() - start) * 100 / ((uint64_t)reps * len * 64 * 16));
+    serial_print("\n");
+}
+
+/* Compares fill_polygon against the same convex 16-gon drawn as a triangle fan */
+void polygon_benchmark(uint64_t cpu_freq) {
+    static const struct point gon[16] = {
+        { 240, 100 }, { 234, 131 }, { 217, 157 }, { 191, 174 },
+        { 160, 180 }, { 129, 174 }, { 103, 157 }, {  86, 131 },
+        {  80, 100 }, {  86,  69 }, { 103,  43 }, { 129,  26 },
+        { 160,  20 }, { 191,  26 }, { 217,  43 }, { 234,  69 },
+    };
+    const int passes = 200;
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < passes; i++) {
+        fill_polygon(gon, 16, (uint8_t)i);
+    }
+    uint64_t poly_cycles = rdtsc() - start;
+
+    start = rdtsc();
+    for (int i = 0; i < passes; i++) {
+        for (int t = 1; t < 15; t++) {
+            draw_triangle(gon[0].x, gon[0].y, gon[t].x, gon[t].y, gon[t + 1].x, gon[t + 1].y, (uint8_t)i);
+        }
+    }
+    uint64_t fan_cycles = rdtsc() - start;
+
+    serial_print("fill_polygon 16-gon: ");
+    serial_print_dec(poly_cycles / passes);
+    serial_print(" cycles, triangle fan: ");
+    serial_print_dec(fan_cycles / passes);
+    serial_print(" cycles (");
+    serial_print_dec(cpu_freq / (poly_cycles / passes + 1));
+    serial_print(" vs ");
+    serial_print_dec(cpu_freq / (fan_cycles / passes + 1));
+    serial_print(" polygons/s)\n");
+}
+#endif
+
+/* --- Frame governor ---
+ * Measures the cycles of each frame against a budget, 16 ms unless the
+ * console sets another, and sheds scenery when frames keep running over.
+ * GOVERNOR_DOWN_FRAMES frames in a row over budget step one quality level
+ * down. GOVERNOR_UP_FRAMES in a row under GOVERNOR_HEADROOM percent of it
+ * step one back up. If a level is knocked down again soon after it
+ * returned, the wait before the next try doubles, so a scene that only just
+ * fits does not flap between levels. Keys, the typed text and the cursor
+ * are handled at every level; only scenery is shed.
+ */
+#define GOVERNOR_BUDGET_MS    16
+#define GOVERNOR_DOWN_FRAMES  4
+#define GOVERNOR_UP_FRAMES    120 // 2 s at 60 Hz
+#define GOVERNOR_UP_MAX_SHIFT 4   // so at most 32 s
+#define GOVERNOR_HEADROOM     60  // percent of the budget
+
+#define QUALITY_FULL        0
+#define QUALITY_NO_OVERLAYS 1 // no blended drop shadow
+#define QUALITY_STATIC_SLOW 2 // static layer every SCENE_STATIC_EVERY frames
+#define QUALITY_FROZEN      3 // animation stops, only the cursor moves
+#define QUALITY_LEVELS      4
+
+static const char* const quality_names[QUALITY_LEVELS] = { "full", "no overlays", "static 1/4", "frozen" };
+
+struct governor {
+    uint32_t budget_ms;
+    int level;
+    int pinned;                   // level fixed from the console, -1 = adapt
+    uint32_t over_run, under_run; // consecutive frames over budget, under the headroom
+    uint32_t up_shift;            // stepping up waits GOVERNOR_UP_FRAMES << up_shift
+    uint32_t frames_since_up;
+    uint32_t frames, over_budget, changes;
+    uint32_t worst_cycles;
+};
+
+static struct governor governor = {
+    .budget_ms = GOVERNOR_BUDGET_MS,
+    .level = QUALITY_FULL,
+    .pinned = -1,
+    .frames_since_up = GOVERNOR_UP_FRAMES,
+};
+
+uint64_t governor_budget_cycles() {
+    return tsc_per_ms * governor.budget_ms;
+}
+
+static void governor_set(int level, uint32_t cycles) {
+    serial_print("governor: ");
+    serial_print(quality_names[governor.level]);
+    serial_print(" -> ");
+    serial_print(quality_names[level]);
+    if (cycles) {
+        serial_print(", frame ");
+        serial_print_centi((uint64_t)cycles * 100 / tsc_per_ms);
+        serial_print(" ms of ");
+        serial_print_dec(governor.budget_ms);
+    }
+    serial_print("\n");
+
+    governor.level = level;
+    governor.over_run = governor.under_run = 0;
+    governor.changes++;
+    scene_refresh = 1;
+}
+
+/* Takes the cycles the frame just drawn needed and picks the next frame's level */
+void governor_frame(uint32_t cycles) {
+    uint64_t budget = governor_budget_cycles();
+    governor.frames++;
+    if (governor.frames_since_up < 0xFFFFFFFF) governor.frames_since_up++;
+    if (cycles > governor.worst_cycles) governor.worst_cycles = cycles;
+
+    if (cycles > budget) {
+        governor.over_budget++;
+        governor.over_run++;
+        governor.under_run = 0;
+    } else {
+        governor.over_run = 0;
+        governor.under_run = (uint64_t)cycles * 100 <= budget * GOVERNOR_HEADROOM ? governor.under_run + 1 : 0;
+    }
+    if (governor.pinned >= 0) return;
+
+    if (governor.over_run >= GOVERNOR_DOWN_FRAMES && governor.level < QUALITY_LEVELS - 1) {
+        if (governor.frames_since_up >= GOVERNOR_UP_FRAMES) {
+            governor.up_shift = 0;
+        } else if (governor.up_shift < GOVERNOR_UP_MAX_SHIFT) {
+            governor.up_shift++;
+        }
+        governor_set(governor.level + 1, cycles);
+    } else if (governor.under_run >= ((uint32_t)GOVERNOR_UP_FRAMES << governor.up_shift) && governor.level > QUALITY_FULL) {
+        governor_set(governor.level - 1, cycles);
+        governor.frames_since_up = 0;
+    }
+}
+
+/* Level for the next frame; replays always draw the full scene so their timings compare */
+int governor_quality() {
+    return input_replaying() ? QUALITY_FULL : governor.level;
+}
+
+/* Fixes the level (0 to QUALITY_LEVELS - 1), or lets it adapt again with -1 */
+void governor_pin(int level) {
+    governor.pinned = level;
+    if (level >= 0 && level != governor.level) governor_set(level, 0);
+}
+
+void governor_report() {
+    serial_print("governor: ");
+    serial_print(quality_names[governor.level]);
+    serial_print(governor.pinned >= 0 ? " (pinned), budget " : ", budget ");
+    serial_print_dec(governor.budget_ms);
+    serial_print(" ms, ");
+    serial_print_dec(governor.over_budget);
+    serial_print(" of ");
+    serial_print_dec(governor.frames);
+    serial_print(" frames over, worst ");
+    serial_print_centi((uint64_t)governor.worst_cycles * 100 / tsc_per_ms);
+    serial_print(" ms, ");
+    serial_print_dec(governor.changes);
+    serial_print(" level changes\n");
+}
+
+/* --- Scene ---
+ * The desktop is a static layer (background, bars, text, the pulsing box)
+ * under the moving parts (bouncing box, spinning triangle, cursor). From
+ * QUALITY_STATIC_SLOW on, the static layer is drawn only every
+ * SCENE_STATIC_EVERY frames, or when scene_refresh says it changed, and is
+ * then copied aside. Frames in between copy back just the rectangles the
+ * moving parts covered last frame. QUALITY_FROZEN draws the stopped shapes
+ * into the static layer and redraws it only on scene_refresh, so a frame
+ * costs about two cursor-sized copies.
+ */
+#define SCENE_STATIC_EVERY 4
+#define SCENE_MAX_DAMAGE   4
+#define SCENE_BACKGROUND   0x38
+
+static uint8_t scene_static[VGA_MODE13_WIDTH * VGA_MODE13_HEIGHT];
+static struct rect scene_damage[SCENE_MAX_DAMAGE];
+static int scene_damage_count = 0;
+static uint32_t scene_static_age = 0;
+
+static void scene_damage_add(int x0, int y0, int x1, int y1) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > VGA_MODE13_WIDTH) x1 = VGA_MODE13_WIDTH;
+    if (y1 > VGA_MODE13_HEIGHT) y1 = VGA_MODE13_HEIGHT;
+    if (x0 >= x1 || y0 >= y1 || scene_damage_count == SCENE_MAX_DAMAGE) return;
+    scene_damage[scene_damage_count++] = (struct rect){ x0, y0, x1, y1 };
+}
+
+static void scene_repair() {
+    for (int i = 0; i < scene_damage_count; i++) {
+        const struct rect* r = &scene_damage[i];
+        for (int y = r->y0; y < r->y1; y++) {
+            uint32_t offset = y * VGA_MODE13_WIDTH + r->x0;
+            memcpy(VGA_MODE13_ADDR + offset, scene_static + offset, r->x1 - r->x0);
+        }
+    }
+    scene_damage_count = 0;
+}
+
+static void scene_draw_static() {
+    draw_box(0, 0, 320, 200, SCENE_BACKGROUND);
+    draw_box(0, 0, 320, 12, 0x3F);
+    draw_string("minitkernel       ABC     Hello, World!", 4, 3, 0x00);
+    draw_box(0, 188, 320, 200, 0x3F);
+    draw_string("0.0.2             123              test", 4, 190, 0x00);
+    draw_string(typed_text, 4, 178, 0x00);
+    draw_box(135, 75, 195, 135, PULSE_COLOR);
+}
+
+static void scene_draw_moving(int level) {
+    if (level <= QUALITY_FULL) draw_box_shade(44 + boxi, 64, 104 + boxi, 124, SHADE_LEVELS / 2);
+    draw_box(40 + boxi, 60, 100 + boxi, 120, 0x04);
+    scene_damage_add(40 + boxi, 60, 105 + boxi, 125);
+
+    // the triangle spins about its centroid as it bounces
+    static const struct fix_vec2 triangle[3] = {
+        { 0, -33 * FIX_ONE - FIX_ONE / 3 },
+        { -30 * FIX_ONE, 16 * FIX_ONE + FIX_ONE * 2 / 3 },
+        { 30 * FIX_ONE, 16 * FIX_ONE + FIX_ONE * 2 / 3 },
+    };
+    struct fix_transform spin;
+    struct fix_point tri[3];
+    fix_transform_set(&spin, scene_angle, FIX_ONE, fix_from_int(260), fix_from_int(108 + boxi) + FIX_ONE / 3);
+    fix_transform_points(&spin, triangle, tri, 3);
+    draw_triangle(tri[0].x, tri[0].y, tri[1].x, tri[1].y, tri[2].x, tri[2].y, 0x06);
+    scene_damage_add(260 - 36, 108 + boxi - 36, 260 + 37, 108 + boxi + 37); // vertices lie within 34.3 pixels
+}
+
+/* Draws one frame of the desktop at a governor quality level */
+void scene_draw(int level) {
+    if (level < QUALITY_FROZEN) {
+        if (boxi >= 20) {
+            box_direction = -1;
+        } else if (boxi <= -20) {
+            box_direction = 1;
+        }
+        boxi += box_direction;
+        scene_angle = (scene_angle + 4) & (FIX_ANGLES - 1);
+    }
+
+    int layered = level >= QUALITY_STATIC_SLOW;
+    int periodic = level == QUALITY_STATIC_SLOW && ++scene_static_age >= SCENE_STATIC_EVERY;
+    if (!layered || scene_refresh || periodic) {
+        scene_draw_static();
+        scene_damage_count = 0;
+        if (level >= QUALITY_FROZEN) scene_draw_moving(level);
+        if (layered) memcpy(scene_static, VGA_MODE13_ADDR, sizeof(scene_static));
+        scene_damage_count = 0;
+        scene_static_age = 0;
+        scene_refresh = 0;
+    } else {
+        scene_repair();
+    }
+    if (level < QUALITY_FROZEN) scene_draw_moving(level);
+
+    latency_mouse_applied(mouse_apply());
+    draw_mouse_cursor(mouse_x, mouse_y);
+    scene_damage_add(mouse_x - 1, mouse_y + 1, mouse_x - 1 + CURSOR_WIDTH, mouse_y + 1 + CURSOR_HEIGHT);
+}
+
+/* --- Boot modules ---
+ * GRUB modules stay where the loader put them; MTI1 images are decoded
+ * straight from module memory onto the screen through mti.h's ring, so the
+ * only memory a splash costs is the decoder below. The splash stays up
+ * while the rest of boot runs; the main loop takes it down after SPLASH_MS
+ * or at the first key.
+ */
+#define SPLASH_MS         1500
+#define SPLASH_FADE_STEPS 32
+
+static struct mti_decoder splash_decoder;
+static uint8_t splash_saved_palette[256][3];
+static struct mti_image splash_image;
+static uint64_t splash_deadline;
+static int splash_showing = 0;
+
+static const char* const mti_codec_names[] = { "raw", "RLE", "LZ4" };
+
+/* Draws img centered and logs decode throughput; returns 0 on success */
+int splash_draw(const struct mti_image* img, uint32_t module_size, uint64_t cpu_freq) {
+    memcpy(splash_saved_palette, palette_base, sizeof(splash_saved_palette));
+    if (img->palette_count) {
+        palette_set_range(img->palette_first, img->palette_count, img->palette);
+        palette_flush();
+    }
+
+    uint64_t start = rdtsc();
+    int result = mti_draw(&splash_decoder, img, VGA_MODE13_ADDR, VGA_MODE13_WIDTH,
+                          VGA_MODE13_WIDTH, VGA_MODE13_HEIGHT,
+                          (VGA_MODE13_WIDTH - img->width) / 2, (VGA_MODE13_HEIGHT - img->height) / 2);
+    uint64_t cycles = rdtsc() - start;
+    uint64_t pixels = (uint64_t)img->width * img->height;
+
+    serial_print("splash: ");
+    serial_print_dec(img->width);
+    serial_print("x");
+    serial_print_dec(img->height);
+    serial_print(" ");
+    serial_print(mti_codec_names[img->codec]);
+    serial_print(", ");
+    serial_print_dec(module_size);
+    serial_print(" -> ");
+    serial_print_dec(pixels);
+    serial_print(" bytes in ");
+    serial_print_dec(cycles);
+    serial_print(" cycles (");
+    serial_print_dec(pixels * cpu_freq / (cycles + 1) / 1000000);
+    serial_print(" MB/s, ");
+    serial_print_centi(cycles * 100 / (pixels + 1));
+    serial_print(" cycles/pixel), peak memory ");
+    serial_print_dec(sizeof(splash_decoder));
+    serial_print(" bytes");
+    serial_print(result ? ", CORRUPT\n" : "\n");
+    return result;
+}
+
+/* Fades the splash palette out and puts the previous colors back */
+void splash_dismiss(const struct mti_image* img) {
+    if (img->palette_count) {
+        for (int step = SPLASH_FADE_STEPS - 1; step >= 0; step--) {
+            palette_fade(img->palette_first, img->palette_count, step * 256 / SPLASH_FADE_STEPS);
+            palette_flush();
+        }
+        palette_set_range(img->palette_first, img->palette_count, splash_saved_palette[img->palette_first]);
+    }
+    clear_screen();
+    palette_flush();
+}
+
+/* Runs in each frame slot while the splash is up; returns 1 until a key or SPLASH_MS ends it */
+int splash_update() {
+    if (!splash_showing) return 0;
+    uint64_t received;
+    if (!key_pop(&received) && !deadline_passed(splash_deadline)) return 1;
+    splash_showing = 0;
+    splash_dismiss(&splash_image);
+    scene_refresh = 1;
+    return 0;
+}
+
+/* Logs the Multiboot modules and puts up the first MTI1 image among them; boot goes on behind it */
+void boot_modules(uint32_t magic, const struct multiboot_info* mbi, uint64_t cpu_freq) {
+    uint32_t count;
+    const struct multiboot_module* mods = multiboot_modules(magic, mbi, &count);
+    int shown = 0;
+
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        serial_print("Not loaded by a Multiboot loader, no modules\n");
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* data = (const uint8_t*)mods[i].mod_start;
+        uint32_t size = mods[i].mod_end - mods[i].mod_start;
+        struct mti_image img;
+
+        serial_print("module ");
+        serial_print_dec(i);
+        serial_print(": ");
+        serial_print_dec(size);
+        serial_print(" bytes at ");
+        serial_print_hex(mods[i].mod_start);
+        if (mods[i].cmdline) {
+            serial_print(" ");
+            serial_print((const char*)mods[i].cmdline);
+        }
+        serial_print("\n");
+
+        if (input_load(data, size) == 0) {
+            serial_print("Input recording: ");
+            serial_print_dec(input_recorded_frames);
+            serial_print(" frames, replaying from the first\n");
+            continue;
+        }
+        if (shown || mti_parse(data, size, &img) != 0) continue;
+        shown = 1;
+        splash_draw(&img, size, cpu_freq);
+        splash_image = img;
+        splash_deadline = deadline_after_ms(SPLASH_MS);
+        splash_showing = 1;
+    }
+}
+
+/* --- Frame capture ---
+ * With "capture" on the kernel command line, every rendered frame goes out
+ * over COM1 between the log lines, for headless runs (tools/fbcapture.py
+ * turns the stream back into PNGs). The first frame, and every
+ * CAPTURE_KEYFRAME_INTERVAL-th after it, is a keyframe: the full palette,
+ * then the screen RLE-encoded. Other frames send the palette entries that
+ * changed and, for each changed row, the RLE-encoded XOR against the last
+ * frame sent. Packets look like
+ *
+ *   0xFB 'M' 'T' 'F'  type  frame (u32 LE)  length (u32 LE)  payload  CRC-32 (u32 LE)
+ *
+ * with the CRC over everything from type to the end of the payload.
+ * K payload: width, height (u16 LE each), RLE pixels.
+ * D payload: repeated row number (u8), RLE of the row's 320 XOR bytes.
+ * P payload: first entry (u8), count (u16 LE), count * 3 6-bit components.
+ *
+ * Capture is a headless-only mode: each packet is written synchronously at
+ * 115200 baud, so a keyframe (up to ~64 KB) stalls rendering for seconds
+ * and even small deltas cost frames. Timing figures from a capture run
+ * mean nothing.
+ */
+#define CAPTURE_KEYFRAME_INTERVAL 256
+#define CAPTURE_PIXELS  (VGA_MODE13_WIDTH * VGA_MODE13_HEIGHT)
+#define CAPTURE_BUFFER  (CAPTURE_PIXELS + VGA_MODE13_HEIGHT * 4 + 64) // every row changed, all literals
+
+static int capture_enabled = 0;
+static uint32_t capture_frame_count = 0;
+static uint8_t capture_prev[CAPTURE_PIXELS] __attribute__((aligned(16)));
+static uint8_t capture_palette[256][3];
+static uint8_t capture_buffer[CAPTURE_BUFFER];
+static uint32_t crc32_table[256];
+static uint64_t capture_bytes = 0;
+
+void crc32_init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_table[i] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, uint32_t n) {
+    while (n--) crc = crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void capture_send(char type, const uint8_t* payload, uint32_t length) {
+    uint8_t header[13] = { 0xFB, 'M', 'T', 'F', (uint8_t)type };
+    uint8_t trailer[4];
+    put32(header + 5, capture_frame_count);
+    put32(header + 9, length);
+
+    uint32_t crc = crc32_update(0xFFFFFFFF, header + 4, 9);
+    crc = crc32_update(crc, payload, length);
+    put32(trailer, ~crc);
+
+    serial_write(header, sizeof(header));
+    serial_write(payload, length);
+    serial_write(trailer, sizeof(trailer));
+    capture_bytes += sizeof(header) + length + sizeof(trailer);
+}
+
+static void capture_send_palette(int first, int count) {
+    capture_buffer[0] = first;
+    capture_buffer[1] = count & 0xFF;
+    capture_buffer[2] = count >> 8;
+    memcpy(capture_buffer + 3, capture_palette[first], count * 3);
+    capture_send('P', capture_buffer, 3 + count * 3);
+}
+
+void capture_init(uint32_t magic, const struct multiboot_info* mbi) {
+    capture_enabled = multiboot_cmdline_has(magic, mbi, "capture");
+    if (capture_enabled) {
+        crc32_init();
+        serial_print("Frame capture on\n");
+    }
+}
+
+static void capture_keyframe() {
+    memcpy(capture_palette, palette_shadow, sizeof(capture_palette));
+    capture_send_palette(0, 256);
+
+    memcpy(capture_prev, VGA_MODE13_ADDR, CAPTURE_PIXELS);
+    capture_buffer[0] = VGA_MODE13_WIDTH & 0xFF;
+    capture_buffer[1] = VGA_MODE13_WIDTH >> 8;
+    capture_buffer[2] = VGA_MODE13_HEIGHT;
+    capture_buffer[3] = 0;
+    int n = mti_rle_encode(capture_prev, CAPTURE_PIXELS, capture_buffer + 4, CAPTURE_BUFFER - 4);
+    if (n < 0) {
+        serial_print("capture: keyframe does not fit, frame dropped\n");
+        return;
+    }
+    capture_send('K', capture_buffer, 4 + n);
+}
+
+/* Sends the frame now on screen */
+void capture_frame() {
+    const uint8_t* screen = VGA_MODE13_ADDR;
+
+    if (capture_frame_count % CAPTURE_KEYFRAME_INTERVAL == 0) {
+        capture_keyframe();
+        capture_frame_count++;
+        return;
+    }
+
+    int first = -1, last = -1;
+    for (int i = 0; i < 256; i++) {
+        if (capture_palette[i][0] != palette_shadow[i][0] || capture_palette[i][1] != palette_shadow[i][1] ||
+            capture_palette[i][2] != palette_shadow[i][2]) {
+            if (first < 0) first = i;
+            last = i;
+        }
+    }
+    if (first >= 0) {
+        memcpy(capture_palette[first], palette_shadow[first], (last - first + 1) * 3);
+        capture_send_palette(first, last - first + 1);
+    }
+
+    uint32_t used = 0;
+    uint8_t row_xor[VGA_MODE13_WIDTH] __attribute__((aligned(4)));
+    for (int y = 0; y < VGA_MODE13_HEIGHT; y++) {
+        const uint32_t* cur = (const uint32_t*)(screen + y * VGA_MODE13_WIDTH);
+        uint32_t* prev = (uint32_t*)(capture_prev + y * VGA_MODE13_WIDTH);
+        uint32_t diff = 0;
+        for (int x = 0; x < VGA_MODE13_WIDTH / 4; x++) {
+            uint32_t d = cur[x] ^ prev[x];
+            ((uint32_t*)row_xor)[x] = d;
+            diff |= d;
+            prev[x] = cur[x];
+        }
+        if (!diff) continue;
+
+        capture_buffer[used++] = (uint8_t)y;
+        int n = mti_rle_encode(row_xor, VGA_MODE13_WIDTH, capture_buffer + used, CAPTURE_BUFFER - used);
+        if (n < 0) {
+            // the delta outgrew the buffer; a keyframe resends the whole screen
+            capture_keyframe();
+            capture_frame_count++;
+            return;
         }
+        used += n;
+    }
+    capture_send('D', capture_buffer, used);
+    capture_frame_count++;
+}
+
+/* --- Serial console ---
+ * Lines typed on COM1 run commands from the shell.h table, so headless runs
+ * can be driven and queried from the host.
+ */
+#define SERIAL_LINE_MAX 64
+
+int serial_has_input() {
+    return inb(COM1_PORT + 5) & 0x01;
+}
+
+void cmd_profile(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        profile_reset();
+        serial_print("profile reset\n");
+    } else {
+        profile_dump();
+    }
+}
+
+void cmd_record(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "start") == 0) {
+        input_record_start();
+        serial_print("recording\n");
+    } else if (argc > 1 && strcmp(argv[1], "stop") == 0) {
+        input_record_stop();
+        serial_print("recorded ");
+        serial_print_dec(input_recorded_frames);
+        serial_print(" frames, ");
+        serial_print_dec(input_event_count);
+        serial_print(" events\n");
+    } else if (argc > 1 && strcmp(argv[1], "dump") == 0) {
+        input_dump();
+    } else {
+        serial_print("usage: record start|stop|dump\n");
+    }
+}
+
+void cmd_replay(int argc, char** argv) {
+    (void)argc; (void)argv;
+    if (input_replay_start() != 0) serial_print("nothing recorded\n");
+}
+
+void cmd_latency(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        latency_reset();
+        serial_print("latency reset\n");
+    } else {
+        latency_print("key", &latency_keys);
+        latency_print("mouse", &latency_mouse);
+    }
+}
+
+void cmd_sound(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        static const uint16_t chime[] = {523, 659, 784, 1047}; // C major, one voice each
+        for (int i = 0; i < 4; i++) {
+            if (sound_play(mixer_sine, chime[i], 64, 600 + i * 200) < 0) {
+                serial_print("sound: no card or no free voice\n");
+                return;
+            }
+        }
+    }
+    sb16_report();
+}
+
+void cmd_governor(int argc, char** argv) {
+    uint32_t value;
+    if (argc > 2 && strcmp(argv[1], "budget") == 0 && shell_parse_uint(argv[2], &value) == 0 &&
+        value > 0 && value <= 1000) {
+        governor.budget_ms = value;
+    } else if (argc > 2 && strcmp(argv[1], "level") == 0 && shell_parse_uint(argv[2], &value) == 0 &&
+               value < QUALITY_LEVELS) {
+        governor_pin(value);
+    } else if (argc == 2 && strcmp(argv[1], "auto") == 0) {
+        governor_pin(-1);
+    } else if (argc > 1) {
+        serial_print("usage: governor [budget 1-1000 | level 0-3 | auto]\n");
+        return;
+    }
+    governor_report();
+}
+
+void cmd_help(int argc, char** argv) {
+    (void)argc; (void)argv;
+    for (int i = 0; i < shell_command_count; i++) {
+        serial_print(shell_commands[i].name);
+        serial_print(": ");
+        serial_print(shell_commands[i].help);
+        serial_print("\n");
+    }
+}
+
+void serial_console_init() {
+    shell_register("help", "Lists the serial console commands", cmd_help);
+    shell_register("profile", "Dumps the sampling profile, or clears it with 'reset'", cmd_profile);
+    shell_register("record", "Records PS/2 input per frame: start, stop, or dump the recording", cmd_record);
+    shell_register("replay", "Replays the recording and prints the cycles of each frame", cmd_replay);
+    shell_register("latency", "Prints input-to-screen latency histograms, or clears them with 'reset'", cmd_latency);
+    shell_register("sound", "Prints mixer and underrun counters; 'test' plays a chime", cmd_sound);
+    shell_register("governor", "Shows the frame governor; 'budget ms', 'level n' pins a level, 'auto'", cmd_governor);
+}
+
+/* Runs one command line, from COM1 or the terminal */
+void handle_command(char* cmd) {
+    char* argv[SHELL_MAX_ARGS];
+    int argc = shell_tokenize(cmd, argv, SHELL_MAX_ARGS);
+    const struct shell_command* command = argc ? shell_lookup(argv[0]) : NULL;
+    if (command) {
+        command->handler(argc, argv);
+    } else if (argc) {
+        serial_print("unknown command: ");
+        serial_print(argv[0]);
+        serial_print("\n");
+    }
+}
+
+/* Collects serial input and runs each complete line; never blocks */
+void serial_console_poll() {
+    static char line[SERIAL_LINE_MAX];
+    static int len = 0;
+
+    while (serial_has_input()) {
+        char c = inb(COM1_PORT);
+        if (c != '\r' && c != '\n') {
+            if (len < SERIAL_LINE_MAX - 1) line[len++] = c;
+            continue;
+        }
+        if (len == 0) continue;
+        line[len] = '\0';
+        len = 0;
+
+        handle_command(line);
+    }
+}
+
+/* --- Terminal ---
+ * F1 swaps the scene for a 40x23 text terminal over the 8x8 font that runs
+ * the shell.h commands. Writes only change term_cells and set a dirty bit
+ * per cell; term_flush, once per frame, repaints each run of dirty cells
+ * with one fill and one expand_mask, so a typed character costs its own
+ * 8x8 cell plus the cursor underline. Scrolling shifts the cells at once but
+ * the framebuffer rows only at the next flush, with one memmove however many
+ * lines went by, after which only the rows that came in are dirty.
+ */
+#define TERM_COLS         40
+#define TERM_ROWS         23
+#define TERM_Y            8 // below the title bar
+#define TERM_FG           0x07
+#define TERM_BG           0x00
+#define TERM_PROMPT_COLOR 0x0A
+#define TERM_ALL_DIRTY    ((1ULL << TERM_COLS) - 1)
+
+struct term_cell {
+    uint8_t ch;
+    uint8_t fg;
+    uint8_t bg;
+};
+
+int term_active = 0;
+static struct term_cell term_cells[TERM_ROWS][TERM_COLS];
+static uint64_t term_dirty[TERM_ROWS]; // bit per column
+static int term_row = 0, term_col = 0;
+static int term_scrolled = 0;          // rows the framebuffer still has to move up
+static uint8_t term_color = TERM_FG;
+static uint32_t term_pixels = 0;       // repainted by the last flush
+
+static void term_clear_row(int row) {
+    for (int col = 0; col < TERM_COLS; col++) {
+        term_cells[row][col].ch = ' ';
+        term_cells[row][col].fg = TERM_FG;
+        term_cells[row][col].bg = TERM_BG;
+    }
+    term_dirty[row] = TERM_ALL_DIRTY;
+}
+
+static void term_scroll() {
+    memmove(term_cells[0], term_cells[1], sizeof(term_cells[0]) * (TERM_ROWS - 1));
+    memmove(&term_dirty[0], &term_dirty[1], sizeof(term_dirty[0]) * (TERM_ROWS - 1));
+    term_clear_row(TERM_ROWS - 1);
+    term_scrolled++;
+}
+
+static void term_set(int row, int col, char c) {
+    struct term_cell* cell = &term_cells[row][col];
+    cell->ch = (uint8_t)c;
+    cell->fg = term_color;
+    cell->bg = TERM_BG;
+    term_dirty[row] |= 1ULL << col;
+}
+
+static void term_newline() {
+    term_col = 0;
+    if (++term_row == TERM_ROWS) {
+        term_scroll();
+        term_row = TERM_ROWS - 1;
+    }
+}
+
+void term_putc(char c) {
+    if (c == '\n') {
+        term_newline();
+    } else if (c == '\b') {
+        if (term_col > 0) {
+            term_col--;
+        } else if (term_row > 0) {
+            term_row--;
+            term_col = TERM_COLS - 1;
+        }
+        term_set(term_row, term_col, ' ');
+    } else if (c >= ' ' && c <= '~') {
+        term_set(term_row, term_col, c);
+        if (++term_col == TERM_COLS) term_newline();
+    }
+}
+
+void term_print(const char* s) {
+    while (*s) term_putc(*s++);
+}
+
+static void term_prompt() {
+    term_color = TERM_PROMPT_COLOR;
+    term_print("> ");
+    term_color = TERM_FG;
+}
+
+void term_init() {
+    for (int row = 0; row < TERM_ROWS; row++) term_clear_row(row);
+    term_print("minitkernel shell, 'help' lists commands\n");
+    term_prompt();
+}
 
-        mouse_poll();
+/* Takes over the screen; every cell is drawn at the next flush */
+void term_enter() {
+    clear_screen();
+    draw_box(0, 0, VGA_MODE13_WIDTH, TERM_Y, 0x3F);
+    draw_string("minitkernel terminal        F1: scene", 4, 0, 0x00);
+    for (int row = 0; row < TERM_ROWS; row++) term_dirty[row] = TERM_ALL_DIRTY;
+    term_scrolled = 0;
+    term_active = 1;
+}
+
+void term_leave() {
+    term_active = 0;
+}
+
+/* Line editing; Enter runs the line, its output shown here as well as on COM1 */
+void term_key(char c) {
+    if (c == '\n') {
+        term_putc('\n');
+        input_buffer[input_len] = '\0';
+        serial_echo = term_putc;
+        handle_command(input_buffer);
+        serial_echo = NULL;
+        input_len = 0;
+        term_prompt();
+    } else if (c == '\b') {
+        if (input_len > 0) {
+            input_len--;
+            term_putc('\b');
+        }
+    } else if (c >= ' ' && c <= '~' && input_len < (int)sizeof(input_buffer) - 1) {
+        input_buffer[input_len++] = c;
+        term_putc(c);
+    }
+}
+
+// Paints n cells of one row that share their colors: one fill, one mask expand
+static void term_draw_run(int row, int col, int n) {
+    const struct term_cell* cell = &term_cells[row][col];
+    uint8_t* dst = VGA_MODE13_ADDR + (TERM_Y + row * 8) * VGA_MODE13_WIDTH + col * 8;
+    uint8_t bits[TERM_COLS * 8];
+
+    for (int y = 0; y < 8; y++) {
+        raster->fill_span(dst + y * VGA_MODE13_WIDTH, cell->bg, n * 8);
+        for (int i = 0; i < n; i++) bits[y * n + i] = font8x8_basic[cell[i].ch & 0x7F][y];
+    }
+    raster->expand_mask(dst, VGA_MODE13_WIDTH, bits, n, 8, cell->fg);
+    term_pixels += n * 64;
+}
+
+/* Brings the screen up to date with term_cells; call once per frame */
+void term_flush() {
+    static int cursor_row = -1, cursor_col = 0; // where the underline was drawn
+    uint8_t* top = VGA_MODE13_ADDR + TERM_Y * VGA_MODE13_WIDTH;
+
+    term_pixels = 0;
+    if (term_scrolled) {
+        if (term_scrolled < TERM_ROWS) {
+            int bytes = (TERM_ROWS - term_scrolled) * 8 * VGA_MODE13_WIDTH;
+            memmove(top, top + term_scrolled * 8 * VGA_MODE13_WIDTH, bytes);
+            term_pixels += bytes;
+        }
+        cursor_row -= term_scrolled;
+        term_scrolled = 0;
+    }
+    if (cursor_row >= 0) term_dirty[cursor_row] |= 1ULL << cursor_col; // erase the old underline
+
+    for (int row = 0; row < TERM_ROWS; row++) {
+        uint64_t dirty = term_dirty[row];
+        term_dirty[row] = 0;
+        for (int col = 0; dirty >> col; ) {
+            if (!((dirty >> col) & 1)) {
+                col++;
+                continue;
+            }
+            const struct term_cell* cell = &term_cells[row][col];
+            int n = 1;
+            while (col + n < TERM_COLS && ((dirty >> (col + n)) & 1) &&
+                   cell[n].fg == cell->fg && cell[n].bg == cell->bg) {
+                n++;
+            }
+            term_draw_run(row, col, n);
+            col += n;
+        }
+    }
+
+    cursor_row = term_row;
+    cursor_col = term_col;
+    raster->fill_span(top + (cursor_row * 8 + 7) * VGA_MODE13_WIDTH + cursor_col * 8, TERM_FG, 8);
+    term_pixels += 8;
+}
+
+/* --- Boot timeline ---
+ * Each init phase records TSC stamps relative to boot_tsc, which boot.s takes
+ * first thing in _start. Phases may overlap. The timeline is printed once the
+ * first frame has been drawn, together with the time-to-first-frame.
+ */
+#define BOOT_MAX_PHASES 16
+
+struct boot_phase {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+extern uint64_t boot_tsc;
+
+static struct boot_phase boot_phases[BOOT_MAX_PHASES];
+static int boot_phase_count = 0;
+static uint64_t boot_first_frame_tsc = 0;
+
+int boot_begin(const char* name) {
+    if (boot_phase_count >= BOOT_MAX_PHASES) return -1;
+    struct boot_phase* p = &boot_phases[boot_phase_count];
+    p->name = name;
+    p->start = rdtsc();
+    p->end = 0;
+    return boot_phase_count++;
+}
+
+void boot_end(int phase) {
+    if (phase >= 0) boot_phases[phase].end = rdtsc();
+}
+
+static void serial_print_ms(uint64_t tsc) {
+    serial_print_centi((tsc - boot_tsc) * 100 / tsc_per_ms);
+}
+
+void boot_timeline_print() {
+    serial_print("Boot timeline (ms after _start):\n");
+    for (int i = 0; i < boot_phase_count; i++) {
+        const struct boot_phase* p = &boot_phases[i];
+        serial_print("  ");
+        serial_print_ms(p->start);
+        serial_print(" - ");
+        serial_print_ms(p->end ? p->end : p->start);
+        serial_print("  ");
+        serial_print(p->name);
+        serial_print("\n");
+    }
+    serial_print("Time to first frame: ");
+    serial_print_ms(boot_first_frame_tsc);
+    serial_print(" ms\n");
+}
+
+void kernel_main(uint32_t multiboot_magic, const struct multiboot_info* mbi) {
+    int phase = boot_begin("serial, IDT, CPU features");
+    serial_init();
+    idt_init();
+    __asm__ volatile ("sti"); // every IRQ line stays masked until a driver installs a handler
+    serial_print(sse_enabled ? "FPU: x87 + SSE, lazy switching\n" : fpu_present ? "FPU: x87, lazy switching\n" : "FPU: none\n");
+    mem_init();
+    raster_init();
+    glyph_atlas_init();
+    cursor_init();
+    boot_end(phase);
+
+    // TSC calibration, the mode set and the mouse ACK all wait on hardware: overlap them
+    int calibration = boot_begin("TSC calibration");
+    pit_calibration_begin();
+
+    phase = boot_begin("VGA mode 13h, palette");
+    set_vga_mode_13();
+    palette_init();
+    palette_set_range(PULSE_COLOR, 1, palette_base[0x07]);
+    palette_set_volatile(PULSE_COLOR, 1);
+    boot_end(phase);
+
+    int mouse_phase = boot_begin("mouse probe");
+    int mouse_ok = mouse_init_begin() == 0;
+
+    uint64_t cpu_freq = pit_calibration_end();
+    boot_end(calibration);
+    if (cpu_freq >= 1000) tsc_per_ms = cpu_freq / 1000;
+    uint64_t ticks_per_ms = tsc_per_ms;
+    profile_init();
+    serial_console_init();
+    term_init();
+    serial_print("CPU: ");
+    serial_print_dec(cpu_freq / 1000000);
+    serial_print(" MHz\n");
+
+#ifdef KERNEL_BENCH
+    phase = boot_begin("benchmarks");
+    mem_benchmark(cpu_freq);
+    polygon_benchmark(cpu_freq);
+    transform_benchmark(cpu_freq);
+    text_benchmark();
+    boot_end(phase);
+#endif
+
+    phase = boot_begin("blend tables");
+    blend_build();
+    boot_end(phase);
+    blend_report();
+
+    capture_init(multiboot_magic, mbi);
+    if (multiboot_cmdline_has(multiboot_magic, mbi, "record")) {
+        input_record_start();
+        serial_print("Recording input from the first frame\n");
+    }
+
+    phase = boot_begin("boot modules");
+    boot_modules(multiboot_magic, mbi, cpu_freq);
+    boot_end(phase);
+
+    phase = boot_begin("ATA probe");
+    if (ata_init() == 0) {
+        bcache_init();
+#ifdef KERNEL_BENCH
+        disk_benchmark(cpu_freq);
+#endif
+    }
+    boot_end(phase);
+
+    phase = boot_begin("SB16 probe");
+    if (sb16_init() == 0) {
+        serial_print("SB16: DSP ");
+        serial_print_dec(sb16_version >> 8);
+        serial_print(".");
+        serial_print_dec(sb16_version & 0xFF);
+        serial_print(", 16-bit auto-init DMA 5, IRQ 5, ");
+        serial_print_dec(SB16_RATE);
+        serial_print(" Hz\n");
+    } else {
+        serial_print("SB16: not found, continuing without sound\n");
+    }
+    boot_end(phase);
+
+    int packet_size = mouse_ok ? mouse_init_end(MOUSE_SAMPLE_RATE, 1) : -1;
+    boot_end(mouse_phase);
+    if (packet_size > 0) {
+        mouse_packet_size = packet_size;
+        serial_print(packet_size == 4 ? "Mouse: IntelliMouse, wheel on\n" : "Mouse: standard 3-byte packets\n");
+    } else {
+        serial_print("Mouse: no ACK, continuing without it\n");
+    }
+
+    if (!splash_showing) clear_screen();
+
+    uint64_t last_render_time = 0;
+
+    while (1) {
+        input_poll();
+        serial_console_poll();
 
         uint64_t now = rdtsc();
-        if ((now - last_render_time) >= ticks_per_ms * 16) {
+        if (input_replaying() || (now - last_render_time) >= ticks_per_ms * governor.budget_ms) {
             last_render_time = now;
+            if (splash_update()) continue;
+            input_frame_begin();
+            uint64_t frame_start = rdtsc();
+
+            char c;
+            uint64_t received;
+            while ((c = key_pop(&received)) != 0) {
+                if (c == KEY_F1) {
+                    if (term_active) term_leave(); else term_enter();
+                    scene_refresh = 1;
+                } else if (term_active) {
+                    term_key(c);
+                } else {
+                    typed_add(c);
+                    scene_refresh = 1;
+                    sound_play(mixer_square, 880, 48, 30); // key click
+                }
+                if (received) latency_reflect(&latency_keys, received);
+            }
+
+            if (term_active) {
+                term_flush();
+                latency_mouse_applied(0); // no cursor over the terminal, motion waits for the scene
+            } else {
+                scene_draw(governor_quality());
+            }
+            uint32_t frame_cycles = (uint32_t)(rdtsc() - frame_start);
+            input_frame_end(frame_cycles);
+            if (!input_replaying()) governor_frame(frame_cycles);
 
-            draw_box(0, 0, 320, 200, 0x38);
-            draw_box(0, 0, 320, 12, 0x3F);
-            draw_string("minitkernel       ABC     Hello, World!", 4, 3, 0x00);
-            draw_box(0, 188, 320, 200, 0x3F);
-            draw_string("0.0.2             123              test", 4, 190, 0x00);
+            palette_fade(PULSE_COLOR, 1, 136 + boxi * 6);
+            latency_present(palette_flush());
+            if (capture_enabled) capture_frame();
 
-            if (boxi >= 20) {
-                direction = -1;
-            } else if (boxi <= -20) {
-                direction = 1;
+            if (!boot_first_frame_tsc) {
+                boot_first_frame_tsc = rdtsc();
+                boot_timeline_print();
             }
-            boxi += direction;
-            draw_box(40 + boxi, 60, 100 + boxi, 120, 0x04);
-            draw_triangle(260, 75 + boxi, 230, 125 + boxi, 290, 125 + boxi, 0x06);
-            draw_box(145 - boxi/2, 85 - boxi/2, 185 + boxi/2, 125 + boxi/2, 0x08);
-            draw_mouse_cursor(mouse_x, mouse_y, 0x3F);
-            draw_mouse_cursor_outline(mouse_x, mouse_y, 0x00);
         }
     }
 }
@@ -1,23 +1,58 @@
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <shell.h>
+#include <multiboot.h>
+#include <initrd.h>
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 #define VGA_SIZE (VGA_WIDTH * VGA_HEIGHT)
 #define VGA_ADDR (uint16_t*)0xB8000
-#define WHITE_ON_BLACK 0x0F
+#define VGA_BLACK      0x00
+#define VGA_BLUE       0x01
+#define VGA_GREEN      0x02
+#define VGA_CYAN       0x03
+#define VGA_RED        0x04
+#define VGA_MAGENTA    0x05
+#define VGA_BROWN      0x06
+#define VGA_LIGHT_GRAY 0x07
+#define VGA_DARK_GRAY  0x08
+#define VGA_LIGHT_RED  0x0C
+#define VGA_YELLOW     0x0E
+#define VGA_WHITE      0x0F
+#define VGA_ATTR(fg, bg) ((uint8_t)(((bg) << 4) | (fg)))
+#define WHITE_ON_BLACK VGA_ATTR(VGA_WHITE, VGA_BLACK)
+#define KINFO_COLOR    VGA_ATTR(VGA_WHITE, VGA_RED)
+#define PROMPT_COLOR   VGA_ATTR(VGA_WHITE, VGA_GREEN)
+#define PANIC_COLOR    VGA_ATTR(VGA_WHITE, VGA_BLUE)
 #define VGA_COMMAND_PORT 0x3D4
 #define VGA_DATA_PORT    0x3D5
 #define COM1_PORT 0x3F8
 #define PS2_STATUS 0x64
 #define PS2_DATA   0x60
 #define MAX_INPUT 4096
+#define SCROLLBACK_LINES 4096 // must be a power of two
+#define SCROLLBACK_MASK (SCROLLBACK_LINES - 1)
+#define BLANK_CELL (' ' | (WHITE_ON_BLACK << 8))
+#define ALL_ROWS_DIRTY ((1u << VGA_HEIGHT) - 1)
 uint8_t vga_color = WHITE_ON_BLACK;
 
-static uint16_t cursor_row = 0;
+static uint16_t console_lines[SCROLLBACK_LINES][VGA_WIDTH];
+static uint32_t console_first = 0;     // oldest line still held in the ring
+static uint32_t console_end = 0;       // newest line allocated in the ring
+static uint32_t console_last_used = 0; // newest line holding text
+static int console_empty = 1;
+static uint32_t cursor_line = 0;
 static uint16_t cursor_col = 0;
+static uint32_t view_top = 0;          // line shown on the first screen row
+static int view_follow = 1;            // keep the cursor line in view
+static uint32_t dirty_rows = 0;        // one bit per screen row
+static uint16_t hw_cursor_pos = 0xFFFF;
 char input_buffer[MAX_INPUT];
 int input_len = 0;
 int shell_running = 1;
+static char* command_end;              // end of the line being run, before tokenizing
 
 #ifdef kinfo_SERIAL
 #define print_kinfo_raw(msg) serial_print(msg)
@@ -52,23 +87,6 @@ void sleep(int ticks) {
     for (volatile int i = 0; i < ticks * 100000; i++);
 }
 
-/* --- strcmp minimal --- */
-int strcmp(const char* a, const char* b) {
-    while (*a && (*a == *b)) {
-        a++; b++;
-    }
-    return *(const unsigned char*)a - *(const unsigned char*)b;
-}
-
-/* --- strncmp minimal --- */
-int strncmp(const char* a, const char* b, int n) {
-    while (n-- && *a && (*a == *b)) {
-        a++; b++;
-    }
-    if (n < 0) return 0;
-    return *(const unsigned char*)a - *(const unsigned char*)b;
-}
-
 /* --- VGA cursor --- */
 void move_cursor(uint16_t row, uint16_t col) {
     uint16_t pos = row * VGA_WIDTH + col;
@@ -79,97 +97,200 @@ void move_cursor(uint16_t row, uint16_t col) {
 }
 
 /* --- VGA output --- */
+static const struct {
+    const char* name;
+    uint8_t value;
+} vga_color_names[] = {
+    { "black",     VGA_BLACK },
+    { "blue",      VGA_BLUE },
+    { "green",     VGA_GREEN },
+    { "cyan",      VGA_CYAN },
+    { "red",       VGA_RED },
+    { "magenta",   VGA_MAGENTA },
+    { "brown",     VGA_BROWN },
+    { "lightgray", VGA_LIGHT_GRAY },
+    { "darkgray",  VGA_DARK_GRAY },
+    { "lightred",  VGA_LIGHT_RED },
+    { "yellow",    VGA_YELLOW },
+    { "white",     VGA_WHITE },
+};
+#define VGA_COLOR_NAME_COUNT (sizeof(vga_color_names) / sizeof(vga_color_names[0]))
+static uint32_t vga_color_hashes[VGA_COLOR_NAME_COUNT];
+
+/* Hashes the color names once so lookups only compare a string on a hash hit */
+void init_color_names() {
+    for (unsigned int i = 0; i < VGA_COLOR_NAME_COUNT; i++) {
+        vga_color_hashes[i] = shell_hash(vga_color_names[i].name);
+    }
+}
+
+/* Returns the color value for name, or -1 if unknown */
+int lookup_color(const char* name) {
+    uint32_t hash = shell_hash(name);
+    for (unsigned int i = 0; i < VGA_COLOR_NAME_COUNT; i++) {
+        if (vga_color_hashes[i] == hash && strcmp(vga_color_names[i].name, name) == 0) {
+            return vga_color_names[i].value;
+        }
+    }
+    return -1;
+}
+
 void set_color(const char* name) {
-    uint8_t fg = 0x0F;  // default white
-
-    if (strcmp(name, "black") == 0)        fg = 0x00;
-    else if (strcmp(name, "blue") == 0)    fg = 0x01;
-    else if (strcmp(name, "green") == 0)   fg = 0x02;
-    else if (strcmp(name, "cyan") == 0)    fg = 0x03;
-    else if (strcmp(name, "red") == 0)     fg = 0x04;
-    else if (strcmp(name, "magenta") == 0) fg = 0x05;
-    else if (strcmp(name, "brown") == 0)   fg = 0x06;
-    else if (strcmp(name, "lightgray") == 0) fg = 0x07;
-    else if (strcmp(name, "darkgray") == 0)  fg = 0x08;
-    else if (strcmp(name, "lightred") == 0)  fg = 0x0C;
-    else if (strcmp(name, "yellow") == 0)    fg = 0x0E;
-    else if (strcmp(name, "white") == 0)     fg = 0x0F;
+    int fg = lookup_color(name);
+    if (fg < 0) fg = VGA_WHITE;  // default white
 
     vga_color = (vga_color & 0xF0) | fg;  // preserve background
 }
 
 void set_bgcolor(const char* name) {
-    uint8_t bg = 0x00;  // default black
-
-    if (strcmp(name, "black") == 0)        bg = 0x00;
-    else if (strcmp(name, "blue") == 0)    bg = 0x01;
-    else if (strcmp(name, "green") == 0)   bg = 0x02;
-    else if (strcmp(name, "cyan") == 0)    bg = 0x03;
-    else if (strcmp(name, "red") == 0)     bg = 0x04;
-    else if (strcmp(name, "magenta") == 0) bg = 0x05;
-    else if (strcmp(name, "brown") == 0)   bg = 0x06;
-    else if (strcmp(name, "lightgray") == 0) bg = 0x07;
-    else if (strcmp(name, "darkgray") == 0)  bg = 0x08;
+    int bg = lookup_color(name);
+    if (bg < 0 || bg > VGA_DARK_GRAY) bg = VGA_BLACK;  // default black, no blink bit
 
     vga_color = (vga_color & 0x0F) | (bg << 4);  // preserve foreground
 }
 
-void clear_screen() {
-    volatile uint16_t* vga = VGA_ADDR;
-    uint16_t blank = ' ' | (WHITE_ON_BLACK << 8);
-    for (int i = 0; i < VGA_SIZE; i++) {
-        vga[i] = blank;
+/* --- Console scrollback ---
+ * The console lives in RAM as a ring of SCROLLBACK_LINES lines. Lines are
+ * numbered from 0 since the last clear_screen(), and line n is stored in
+ * slot n & SCROLLBACK_MASK. VRAM is only ever written by console_flush(),
+ * which copies the screen rows that changed since the previous flush.
+ */
+static const uint16_t blank_line[VGA_WIDTH] = { [0 ... VGA_WIDTH - 1] = BLANK_CELL };
+
+static void console_blank_line(uint32_t line) {
+    memcpy(console_lines[line & SCROLLBACK_MASK], blank_line, sizeof(blank_line));
+}
+
+static void console_mark_dirty(uint32_t line) {
+    if (line >= view_top && line < view_top + VGA_HEIGHT) {
+        dirty_rows |= 1u << (line - view_top);
+    }
+}
+
+/* Top line of the view that keeps the cursor line on the last screen row */
+static uint32_t console_bottom_view() {
+    if (cursor_line < console_first + VGA_HEIGHT - 1) return console_first;
+    return cursor_line - (VGA_HEIGHT - 1);
+}
+
+static void console_set_view(uint32_t top) {
+    uint32_t bottom = console_bottom_view();
+    if (top < console_first) top = console_first;
+    if (top > bottom) top = bottom;
+    if (top != view_top) {
+        view_top = top;
+        dirty_rows = ALL_ROWS_DIRTY;
     }
-    cursor_row = 0;
-    cursor_col = 0;
-    move_cursor(cursor_row, cursor_col);
 }
 
-void scroll() {
-    volatile uint16_t* vga = VGA_ADDR;
-    for (int row = 1; row < VGA_HEIGHT; row++) {
-        for (int col = 0; col < VGA_WIDTH; col++) {
-            vga[(row - 1) * VGA_WIDTH + col] = vga[row * VGA_WIDTH + col];
+static void console_goto_line(uint32_t line) {
+    while (console_end < line) {
+        console_end++;
+        console_blank_line(console_end);
+        if (console_end - console_first >= SCROLLBACK_LINES) {
+            console_first = console_end - SCROLLBACK_LINES + 1;
+            // the last line with text scrolled out of the ring: none is left
+            if (console_last_used < console_first) console_empty = 1;
         }
     }
-    uint16_t blank = ' ' | (WHITE_ON_BLACK << 8);
-    for (int col = 0; col < VGA_WIDTH; col++) {
-        vga[(VGA_HEIGHT - 1) * VGA_WIDTH + col] = blank;
+    cursor_line = line;
+    cursor_col = 0;
+    if (view_follow) console_set_view(console_bottom_view());
+}
+
+void console_flush() {
+    uint16_t* vga = VGA_ADDR;
+
+    for (int row = 0; dirty_rows; row++) {
+        if (!(dirty_rows & (1u << row))) continue;
+        dirty_rows &= ~(1u << row);
+
+        uint32_t line = view_top + row;
+        const uint16_t* src = line <= console_end ? console_lines[line & SCROLLBACK_MASK] : blank_line;
+        memcpy(vga + row * VGA_WIDTH, src, sizeof(blank_line));
+    }
+
+    // Park the hardware cursor off-screen while scrolled back past it
+    uint16_t pos = VGA_SIZE;
+    if (cursor_line >= view_top && cursor_line < view_top + VGA_HEIGHT) {
+        pos = (cursor_line - view_top) * VGA_WIDTH + cursor_col;
+    }
+    if (pos != hw_cursor_pos) {
+        hw_cursor_pos = pos;
+        move_cursor(pos / VGA_WIDTH, pos % VGA_WIDTH);
     }
-    if (cursor_row > 0) cursor_row--;
 }
 
-void vga_putc(char c) {
-    volatile uint16_t* vga = VGA_ADDR;
+void clear_screen() {
+    console_first = 0;
+    console_end = 0;
+    console_last_used = 0;
+    console_empty = 1;
+    console_blank_line(0);
+    cursor_line = 0;
+    cursor_col = 0;
+    view_top = 0;
+    view_follow = 1;
+    dirty_rows = ALL_ROWS_DIRTY;
+    console_flush();
+}
+
+void console_page_up() {
+    uint32_t top = view_top - console_first > VGA_HEIGHT - 1 ? view_top - (VGA_HEIGHT - 1) : console_first;
+    view_follow = 0;
+    console_set_view(top);
+    console_flush();
+}
+
+void console_page_down() {
+    console_set_view(view_top + (VGA_HEIGHT - 1));
+    if (view_top == console_bottom_view()) view_follow = 1;
+    console_flush();
+}
+
+/* Writes one character into the scrollback only; callers flush once per burst */
+void console_putc(char c) {
+    if (!view_follow) {
+        view_follow = 1;
+        console_set_view(console_bottom_view());
+    }
 
     if (c == '\n') {
-        cursor_row++;
-        cursor_col = 0;
-    } else if (c == '\b') {
+        console_goto_line(cursor_line + 1);
+        return;
+    }
+
+    uint16_t* cells = console_lines[cursor_line & SCROLLBACK_MASK];
+    if (c == '\b') {
         if (cursor_col > 0) {
             cursor_col--;
-            vga[cursor_row * VGA_WIDTH + cursor_col] = ' ' | (vga_color << 8);
-        }
-    } else {
-        vga[cursor_row * VGA_WIDTH + cursor_col] = c | (vga_color << 8);
-        cursor_col++;
-        if (cursor_col >= VGA_WIDTH) {
-            cursor_col = 0;
-            cursor_row++;
+            cells[cursor_col] = ' ' | (vga_color << 8);
+            console_mark_dirty(cursor_line);
         }
+        return;
     }
 
-    if (cursor_row >= VGA_HEIGHT) {
-        scroll();
+    cells[cursor_col] = (uint8_t)c | (vga_color << 8);
+    console_mark_dirty(cursor_line);
+    if (c != ' ' && (console_empty || cursor_line > console_last_used)) {
+        console_last_used = cursor_line;
+        console_empty = 0;
+    }
+    if (++cursor_col >= VGA_WIDTH) {
+        console_goto_line(cursor_line + 1);
     }
+}
 
-    move_cursor(cursor_row, cursor_col);
+void vga_putc(char c) {
+    console_putc(c);
+    console_flush();
 }
 
 void print(const char* str) {
     while (*str) {
-        vga_putc(*str++);
+        console_putc(*str++);
     }
+    console_flush();
 }
 
 /* --- Serial output --- */
@@ -230,65 +351,57 @@ uint8_t keyboard_read_scancode() {
     }
 }
 
-/* --- Move cursor to the bottom-most empty line or scroll if none --- */
+/* --- Move cursor to the line after the last one holding text --- */
 void move_to_last_line() {
-    volatile uint16_t* vga = VGA_ADDR;
-    for (int row = VGA_HEIGHT - 1; row >= 0; row--) {
-        int empty = 1;
-        for (int col = 0; col < VGA_WIDTH; col++) {
-            uint16_t val = vga[row * VGA_WIDTH + col];
-            if ((val & 0xFF) != ' ') {
-                empty = 0;
-                break;
-            }
-        }
-        if (empty) {
-            cursor_row = row;
-            cursor_col = 0;
-            move_cursor(cursor_row, cursor_col);
-            return;
-        }
-    }
-    scroll();
-    cursor_row = VGA_HEIGHT - 1;
-    cursor_col = 0;
-    move_cursor(cursor_row, cursor_col);
+    console_goto_line(console_empty ? console_first : console_last_used + 1);
+    console_flush();
+}
+
+/* Prints one kinfo line in a single color switch instead of one per fragment */
+void print_kinfo_line(const char* prefix, const char* msg) {
+    uint8_t saved = vga_color;
+    vga_color = KINFO_COLOR;
+    print_kinfo_raw(prefix);
+    print_kinfo_raw(msg);
+    print_kinfo_raw("\n");
+    vga_color = saved;
 }
 
 void print_kinfo(const char* msg) {
-	set_color("white");
-	set_bgcolor("red");
-	print_kinfo_raw(msg);
-	set_color("white");
-	set_bgcolor("black");
+    uint8_t saved = vga_color;
+    vga_color = KINFO_COLOR;
+    print_kinfo_raw(msg);
+    vga_color = saved;
 }
 
 /* --- Command Handling --- */
-void print_help() {
+void cmd_help(int argc, char** argv) {
+    (void)argc; (void)argv;
     print("minitkernel is a \"kernel\" made to learn C and Assembly.\n");
     print("You can currently run:\n");
-    print("    help: Shows help\n");
-    print("    version: Displays version info\n");
-    print("    echo: Echo's whatever is typed after it\n");
-    print("    poweroff: Power off the computer\n");
-    print("    exit: Exits the shell loop\n");
+    for (int i = 0; i < shell_command_count; i++) {
+        print("    ");
+        print(shell_commands[i].name);
+        print(": ");
+        print(shell_commands[i].help);
+        print("\n");
+    }
     print("Thanks for using minitkernel!\n");
 }
 
-void print_version() {
+void cmd_version(int argc, char** argv) {
+    (void)argc; (void)argv;
     print("minitkernel builtin shell ver 0.0.1 running on minitkernel ver 0.0.1\n");
 }
 
 void kernel_panic(const char* printstderror, const char* printdeb, const char* printstdpanic) {
+    uint8_t saved = vga_color;
     clear_screen();
-    set_color("white");
-    set_bgcolor("blue");
+    vga_color = PANIC_COLOR;
     print(printstderror);
     serial_print(printstderror);
     print(printdeb);
     serial_print(printdeb);
-    set_color("white");
-    set_bgcolor("blue");
     print(printstdpanic);
     serial_print(printstdpanic);
     print("FATAL ERROR!\n");
@@ -298,12 +411,12 @@ void kernel_panic(const char* printstderror, const char* printdeb, const char* p
     serial_print("Trying to reexec minitkernel shell...\n");
     print("Successfully restarted minitkernel builtin shell ver 0.0.1\n");
     serial_print("Successfully restarted minitkernel builtin shell ver 0.0.1\n");
-    set_color("white");
-    set_bgcolor("black");
+    vga_color = saved;
     shell_running = 1;
 }
 
-void run_animation() {
+void cmd_animation(int argc, char** argv) {
+    (void)argc; (void)argv;
     clear_screen();
     print("                                   THIS IS                                      ");
     print("                                    A COOL                                      ");
@@ -316,81 +429,137 @@ void run_animation() {
 
 }
 
-void handle_command(const char* cmd) {
-    print_kinfo("Executing command: ");
-    print_kinfo(cmd);
+/* Echoes the rest of the line as typed: the tokenizer only turned its spaces into NULs */
+void cmd_echo(int argc, char** argv) {
+    char* msg = argc > 1 ? argv[1] : command_end;
+    for (char* p = msg; p < command_end; p++) {
+        if (*p == '\0') *p = ' ';
+    }
+    print(msg);
+    print("\n");
+    print_kinfo("Printed: ");
+    print_kinfo(msg);
     print_kinfo("\n");
+}
 
-    if (cmd[0] == '\0') return;
+void cmd_exit(int argc, char** argv) {
+    (void)argc; (void)argv;
+    shell_running = 0;
+    kernel_panic("FATAL: KERNEL PANIC!\n", "ERROR: Tried to KILL shell, panicing\n", "FATAL: PANIC:\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n");
+}
 
-    if (cmd[0] == 'h' && cmd[1] == 'e' && cmd[2] == 'l' && cmd[3] == 'p' &&
-        (cmd[4] == ' ' || cmd[4] == '\0')) {
-        print_help();
+void cmd_setcolor(int argc, char** argv) {
+    set_color(argc > 1 ? argv[1] : "");
+    print("Text color set!\n");
+}
+
+void cmd_setbgcolor(int argc, char** argv) {
+    set_bgcolor(argc > 1 ? argv[1] : "");
+    print("Background color set!\n");
+}
+
+void cmd_poweroff(int argc, char** argv) {
+    (void)argc; (void)argv;
+    print("Powering off.\n");
+    power_off_qemu();
+    print("Poweroff failed, are you on real hardware?\n");
+}
+
+void cmd_ls(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "/";
+    const struct initrd_file* dir = initrd_lookup(path);
+    if (!dir) {
+        print(initrd_file_count ? "No such file or directory\n" : "No initrd loaded\n");
+        return;
     }
-    else if (cmd[0] == 'e' && cmd[1] == 'c' && cmd[2] == 'h' && cmd[3] == 'o' &&
-        (cmd[4] == ' ' || cmd[4] == '\0')) {
-        const char* msg = cmd + 4;
-        while (*msg == ' ') msg++;
-        print(msg);
+    if (dir->type != INITRD_DIR) {
+        print(dir->name);
         print("\n");
-        print_kinfo("Printed: ");
-        print_kinfo(msg);
-        print_kinfo("\n");
+        return;
     }
-    else if (cmd[0] == 'v' && cmd[1] == 'e' && cmd[2] == 'r' && cmd[3] == 's' && cmd[4] == 'i' && cmd[5] == 'o' && cmd[6] == 'n' &&
-        (cmd[7] == ' ' || cmd[7] == '\0')) {
-        print_version();
+    for (const struct initrd_file* f = initrd_first_child(dir); f; f = initrd_next(f)) {
+        print(f->name);
+        print(f->type == INITRD_DIR ? "/\n" : "\n");
     }
-    else if (cmd[0] == 'e' && cmd[1] == 'x' && cmd[2] == 'i' && cmd[3] == 't' &&
-        (cmd[4] == ' ' || cmd[4] == '\0')) {
-        shell_running = 0;
-        kernel_panic("FATAL: KERNEL PANIC!\n", "ERROR: Tried to KILL shell, panicing\n", "FATAL: PANIC:\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000\n");
+}
+
+void cmd_cat(int argc, char** argv) {
+    if (argc < 2) {
+        print("Usage: cat <file>\n");
+        return;
     }
-    else if (strncmp(cmd, "setcolor", 8) == 0 &&
-            (cmd[8] == ' ' || cmd[8] == '\0')) {
-        const char* color = cmd + 8;
-        while (*color == ' ') color++;
-        set_color(color);
-        print("Text color set!\n");
+    for (int i = 1; i < argc; i++) {
+        const struct initrd_file* f = initrd_lookup(argv[i]);
+        if (!f || f->type != INITRD_FILE) {
+            print(argv[i]);
+            print(f ? ": Is a directory\n" : ": No such file\n");
+            continue;
         }
-    else if (strncmp(cmd, "setbgcolor", 10) == 0 &&
-            (cmd[10] == ' ' || cmd[10] == '\0')) {
-        const char* color = cmd + 10;
-        while (*color == ' ') color++;
-        set_bgcolor(color);
-        print("Background color set!\n");
-    }
-    else if (strncmp(cmd, "poweroff", 8) == 0 && (cmd[8] == '\0' || cmd[8] == ' ')) {
-        print("Powering off.\n");
-        power_off_qemu();
-        print("Poweroff failed, are you on real hardware?\n");
-    }
-    else if (strncmp(cmd, "animation", 9) == 0 && (cmd[9] == '\0' || cmd[9] == ' ')) {
-        run_animation();
+        for (uint32_t j = 0; j < f->size; j++) {
+            char c = (char)f->data[j];
+            if (c == '\t') c = ' ';
+            if (c != '\r') console_putc(c);
+        }
+        console_flush();
     }
-    else {
+}
+
+void shell_init() {
+    init_color_names();
+    shell_register("help", "Shows help", cmd_help);
+    shell_register("version", "Displays version info", cmd_version);
+    shell_register("echo", "Echo's whatever is typed after it", cmd_echo);
+    shell_register("setcolor", "Sets the text color", cmd_setcolor);
+    shell_register("setbgcolor", "Sets the background color", cmd_setbgcolor);
+    shell_register("poweroff", "Power off the computer", cmd_poweroff);
+    shell_register("animation", "Plays an animation", cmd_animation);
+    shell_register("exit", "Exits the shell loop", cmd_exit);
+    shell_register("ls", "Lists an initrd directory", cmd_ls);
+    shell_register("cat", "Prints initrd files", cmd_cat);
+}
+
+void handle_command(char* cmd) {
+    print_kinfo_line("Executing command: ", cmd);
+    command_end = cmd + strlen(cmd);
+
+    char* argv[SHELL_MAX_ARGS];
+    int argc = shell_tokenize(cmd, argv, SHELL_MAX_ARGS);
+    if (argc == 0) return;
+
+    const struct shell_command* command = shell_lookup(argv[0]);
+    if (command) {
+        command->handler(argc, argv);
+    } else {
         print("Unknown command: ");
-        print(cmd);
+        print(argv[0]);
         print("\n");
-        print_kinfo("Unknown command: ");
-        print_kinfo(cmd);
-        print_kinfo("\n");
+        print_kinfo_line("Unknown command: ", argv[0]);
     }
 }
 
 /* --- Input shell --- */
-void shell_prompt() {
+void print_prompt() {
+    uint8_t saved = vga_color;
     move_to_last_line();
-    set_color("white");
-    set_bgcolor("green");
+    vga_color = PROMPT_COLOR;
     print("minitkernel:/>");
-    set_color("white");
-    set_bgcolor("black");
+    vga_color = saved;
     print(" ");
     input_len = 0;
+}
+
+void shell_prompt() {
+    int extended = 0; // last byte was the 0xE0 prefix
+    print_prompt();
 
     while (shell_running) {
         uint8_t sc = keyboard_read_scancode();
+        if (sc == 0xE0) {
+            extended = 1;
+            continue;
+        }
+        int was_extended = extended;
+        extended = 0;
 
         // Handle Shift press/release
         if (sc == 0x2A || sc == 0x36) {  // Left or Right Shift press
@@ -402,6 +571,16 @@ void shell_prompt() {
             continue;
         }
 
+        // Page Up/Down (E0 49/E0 51) scroll through the history; bare 49/51 are keypad 9/3
+        if (was_extended && sc == 0x49) {
+            console_page_up();
+            continue;
+        }
+        if (was_extended && sc == 0x51) {
+            console_page_down();
+            continue;
+        }
+
         // Ignore key releases
         if (sc & 0x80) continue;
 
@@ -413,14 +592,7 @@ void shell_prompt() {
             input_buffer[input_len] = '\0';
             handle_command(input_buffer);
             if (!shell_running) break;
-            move_to_last_line();
-            set_color("white");
-            set_bgcolor("green");
-            print("minitkernel:/>");
-            set_color("white");
-            set_bgcolor("black");
-            print(" ");
-            input_len = 0;
+            print_prompt();
         }
         else if (c == '\b') {
             if (input_len > 0) {
@@ -435,9 +607,37 @@ void shell_prompt() {
     }
 }
 
+/* --- Interrupts ---
+ * The safe kernel never loads an IDT, but boot.s' shared entry stubs call
+ * into this, so report anything that arrives here and stop.
+ */
+void isr_dispatch(void* frame) {
+    (void)frame;
+    serial_print("Unexpected interrupt, halting.\n");
+    while (1) __asm__ volatile ("cli; hlt");
+}
+
+/* --- Initrd ---
+ * The first Multiboot module holding a ustar archive becomes the initrd.
+ */
+void initrd_load(uint32_t magic, const struct multiboot_info* mbi) {
+    uint32_t count;
+    const struct multiboot_module* mods = multiboot_modules(magic, mbi, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* data = (const uint8_t*)mods[i].mod_start;
+        if (initrd_init(data, mods[i].mod_end - mods[i].mod_start) > 0) {
+            print_kinfo("Loaded initrd from a boot module\n");
+            return;
+        }
+    }
+    print_kinfo("No initrd module\n");
+}
+
 /* --- Kernel entry point --- */
-void kernel_main() {
+void kernel_main(uint32_t multiboot_magic, const struct multiboot_info* mbi) {
     serial_init();
+    mem_init();
+    shell_init();
 
     print_kinfo("Booting Kernel: minitkernel 0.0.1\n");
     print_kinfo("Clearing VGA Screen\n");
@@ -445,6 +645,7 @@ void kernel_main() {
     clear_screen();
 
     print_kinfo("Cleared VGA Screen\n");
+    initrd_load(multiboot_magic, mbi);
     print_kinfo("Starting Shell: Builtin 0.0.1\n");
 
     print("Welcome to the minitkernel builtin shell version 0.0.1!\n");
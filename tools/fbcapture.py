@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Rebuild frames from a serial log written with "capture" on the kernel command line.
+
+    qemu-system-i386 -kernel kernel.elf -append capture -display none -serial file:serial.log
+    tools/fbcapture.py serial.log frames/
+
+Frame packets are found between ordinary log text, checked against their
+CRC-32 and applied in order (see "Frame capture" in kernel.c). Frames are
+written as frames/frame_NNNNN.png; --every N keeps only every Nth one and
+--last only the final frame. A frame whose packet is damaged is skipped,
+along with all frames up to the next keyframe. The exit status is 1 if any
+packet failed its CRC.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"\xfbMTF"
+HEADER = 13
+
+
+def packets(stream):
+    """Yields (type, frame, payload) for each packet, None for damaged ones."""
+    pos = 0
+    while True:
+        pos = stream.find(MAGIC, pos)
+        if pos < 0 or pos + HEADER > len(stream):
+            return
+        kind, frame, length = struct.unpack_from("<cII", stream, pos + 4)
+        end = pos + HEADER + length
+        if end + 4 > len(stream):
+            return
+        payload = stream[pos + HEADER:end]
+        crc = struct.unpack_from("<I", stream, end)[0]
+        if zlib.crc32(stream[pos + 4:end]) != crc:
+            yield None
+            pos += len(MAGIC)
+            continue
+        yield kind, frame, payload
+        pos = end + 4
+
+
+def rle_decode(data, total):
+    """Decodes total bytes of RLE; returns (bytes, bytes consumed)."""
+    out, i = bytearray(), 0
+    while len(out) < total:
+        c = data[i]
+        i += 1
+        if c < 128:
+            out += data[i:i + c + 1]
+            i += c + 1
+        else:
+            out += bytes([data[i]]) * (c - 125)
+            i += 1
+    return bytes(out), i
+
+
+def png_chunk(kind, data):
+    return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data))
+
+
+def write_png(path, width, height, pixels, palette):
+    rgb = bytes((c * 255 + 31) // 63 for c in palette)
+    rows = b"".join(b"\0" + pixels[y * width:(y + 1) * width] for y in range(height))
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(png_chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 3, 0, 0, 0)))
+        f.write(png_chunk(b"PLTE", rgb))
+        f.write(png_chunk(b"IDAT", zlib.compress(rows, 9)))
+        f.write(png_chunk(b"IEND", b""))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log")
+    parser.add_argument("outdir")
+    parser.add_argument("--every", type=int, default=1, help="write every Nth frame (default 1)")
+    parser.add_argument("--last", action="store_true", help="write only the final frame")
+    args = parser.parse_args()
+
+    with open(args.log, "rb") as f:
+        stream = f.read()
+    os.makedirs(args.outdir, exist_ok=True)
+
+    width = height = 0
+    pixels = None
+    palette = bytearray(768)
+    synced = False
+    frames = damaged = 0
+    last = None
+
+    for packet in packets(stream):
+        if packet is None:
+            damaged += 1
+            synced = False
+            continue
+        kind, frame, payload = packet
+        if kind == b"P":
+            first, count = struct.unpack_from("<BH", payload)
+            palette[first * 3:(first + count) * 3] = payload[3:3 + count * 3]
+            continue
+        if kind == b"K":
+            width, height = struct.unpack_from("<HH", payload)
+            pixels = bytearray(rle_decode(payload[4:], width * height)[0])
+            synced = True
+        elif kind == b"D":
+            if not synced:
+                continue
+            pos = 0
+            while pos < len(payload):
+                y = payload[pos]
+                row, used = rle_decode(payload[pos + 1:], width)
+                base = y * width
+                for x in range(width):
+                    pixels[base + x] ^= row[x]
+                pos += 1 + used
+        else:
+            continue
+
+        frames += 1
+        last = (frame, bytes(pixels), bytes(palette))
+        if not args.last and frame % args.every == 0:
+            write_png(os.path.join(args.outdir, f"frame_{frame:05d}.png"), width, height, pixels, palette)
+
+    if args.last and last:
+        frame, data, pal = last
+        write_png(os.path.join(args.outdir, f"frame_{frame:05d}.png"), width, height, data, pal)
+    print(f"{frames} frames, {damaged} damaged packets")
+    sys.exit(1 if damaged else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Generate include/fixed_tables.h, the lookup tables behind include/fixed.h.
+
+    tools/fixed_tables.py > include/fixed_tables.h    (or: make tables)
+
+fix_sin_table holds sin() in 16.16 for FIX_ANGLES steps per turn, rounded
+to nearest. fix_recip_table[n] is ceil(2^32 / n) for 2 <= n <= FIX_RECIP_MAX:
+an unsigned 32-bit value times it, shifted right by 32, is the quotient by n
+or one more, which fix_div_int corrects. Entries 0 and 1 are unused.
+"""
+
+import argparse
+import math
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--angles", type=int, default=1024, help="steps per turn, a power of two (default 1024)")
+    parser.add_argument("--recip", type=int, default=1024, help="largest divisor with a reciprocal (default 1024)")
+    args = parser.parse_args()
+    if args.angles < 4 or args.angles & (args.angles - 1):
+        parser.error("--angles must be a power of two")
+
+    sines = [round(math.sin(2 * math.pi * i / args.angles) * 65536) for i in range(args.angles)]
+    recips = [0, 0] + [-(-(1 << 32) // n) for n in range(2, args.recip + 1)]
+
+    print("#ifndef MINIMAL_FIXED_TABLES_H")
+    print("#define MINIMAL_FIXED_TABLES_H")
+    print()
+    print("// Generated by tools/fixed_tables.py, do not edit")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print(f"#define FIX_ANGLES    {args.angles}")
+    print(f"#define FIX_RECIP_MAX {args.recip}")
+    print()
+    print("static const int32_t fix_sin_table[FIX_ANGLES] = {")
+    for i in range(0, len(sines), 8):
+        print("    " + " ".join(f"{v}," for v in sines[i:i + 8]))
+    print("};")
+    print()
+    print("static const uint32_t fix_recip_table[FIX_RECIP_MAX + 1] = {")
+    for i in range(0, len(recips), 6):
+        print("    " + " ".join(f"{v}u," for v in recips[i:i + 6]))
+    print("};")
+    print()
+    print("#endif // MINIMAL_FIXED_TABLES_H")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Turn input recordings into replay modules and compare replay frame times.
+
+    tools/inputrec.py pack serial.log session.rec
+    qemu-system-i386 -kernel kernel.elf -initrd session.rec -serial file:a.log
+    tools/inputrec.py compare a.log b.log
+
+pack takes the last "record dump" in a serial log and writes it as an MTIR
+module; booted with it, the kernel replays the session from the first frame
+(see "Input record/replay" in kernel.c). compare reads the last replay report
+from each log and prints frame-time statistics, then how B differs from A.
+Both runs must come from the same recording.
+"""
+
+import argparse
+import struct
+import sys
+
+
+def last_block(path, start, end):
+    with open(path, "rb") as f:
+        lines = f.read().decode("latin-1").splitlines()
+    first = None
+    for i, line in enumerate(lines):
+        if line.startswith(start):
+            first = i
+    if first is None:
+        sys.exit(f"{path}: no {start!r} block found")
+    for i in range(first + 1, len(lines)):
+        if lines[i].strip() == end:
+            return lines[first].split(), [line.split() for line in lines[first + 1:i]]
+    sys.exit(f"{path}: {start!r} block is truncated")
+
+
+def pack(args):
+    header, events = last_block(args.log, "RECORD frames", "RECORD END")
+    frames = int(header[2])
+    if int(header[6]):
+        print(f"warning: {header[6]} events were dropped while recording", file=sys.stderr)
+
+    out = bytearray(b"MTIR" + struct.pack("<II", frames, len(events)))
+    for fields in events:
+        data = bytes.fromhex(fields[2])
+        out += struct.pack("<IBB", int(fields[0]), ord(fields[1]), len(data)) + data.ljust(4, b"\0")
+    with open(args.out, "wb") as f:
+        f.write(out)
+    print(f"{args.out}: {frames} frames, {len(events)} events")
+
+
+def frame_times(path):
+    header, lines = last_block(path, "REPLAY frames", "REPLAY END")
+    return [int(fields[1]) for fields in lines if len(fields) == 2]
+
+
+def stats(cycles):
+    s = sorted(cycles)
+    n = len(s)
+    return {
+        "mean": sum(s) / n,
+        "p50": s[n // 2],
+        "p99": s[min(n - 1, n * 99 // 100)],
+        "max": s[-1],
+    }
+
+
+def compare(args):
+    a = frame_times(args.a)
+    b = frame_times(args.b)
+    if not a or not b:
+        sys.exit("empty replay report")
+    if len(a) != len(b):
+        print(f"warning: {len(a)} frames in A, {len(b)} in B; comparing the first {min(len(a), len(b))}",
+              file=sys.stderr)
+    n = min(len(a), len(b))
+    sa, sb = stats(a[:n]), stats(b[:n])
+
+    print(f"{'cycles':>8} {'A':>12} {'B':>12} {'B/A':>8}")
+    for key in ("mean", "p50", "p99", "max"):
+        print(f"{key:>8} {sa[key]:12.0f} {sb[key]:12.0f} {sb[key] / max(sa[key], 1):8.3f}")
+
+    ratios = sorted(b[i] / max(a[i], 1) for i in range(n))
+    print(f"per frame B/A: median {ratios[n // 2]:.3f}, B faster in {sum(r < 1 for r in ratios)} of {n} frames")
+    worst = sorted(range(n), key=lambda i: b[i] - a[i], reverse=True)[:args.top]
+    print("frames B lost most on:")
+    for i in worst:
+        print(f"  {i:6d} {a[i]:10d} -> {b[i]:10d}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("pack", help="write the last recording in a log as a module")
+    p.add_argument("log")
+    p.add_argument("out")
+    p.set_defaults(run=pack)
+    c = sub.add_parser("compare", help="compare the last replay report of two logs")
+    c.add_argument("a")
+    c.add_argument("b")
+    c.add_argument("--top", type=int, default=5, help="worst frames to list (default 5)")
+    c.set_defaults(run=compare)
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
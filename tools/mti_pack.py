@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Pack a binary PPM (P6) or PGM (P5) image into an MTI1 image for the kernel.
+
+PPM colors become palette entries starting at --palette-first. If the image
+has more distinct colors than fit, it is quantized to a 6x6x6 color cube.
+PGM bytes are used as palette indices unchanged and no palette is stored.
+
+    tools/mti_pack.py splash.ppm splash.mti --codec lz4
+    qemu-system-i386 -kernel kernel.elf -initrd splash.mti -serial stdio
+"""
+
+import argparse
+import struct
+import sys
+
+CODEC_RAW, CODEC_RLE, CODEC_LZ4 = 0, 1, 2
+WINDOW = 4096  # must match MTI_WINDOW in include/mti.h
+MIN_MATCH = 4
+
+
+def read_pnm(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    fields, pos = [], 0
+    while len(fields) < 4:
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b"#":
+            pos = data.index(b"\n", pos)
+            continue
+        start = pos
+        while not data[pos:pos + 1].isspace():
+            pos += 1
+        fields.append(data[start:pos])
+    magic, width, height, maxval = fields[0], int(fields[1]), int(fields[2]), int(fields[3])
+    if magic not in (b"P5", b"P6") or maxval != 255:
+        sys.exit(f"{path}: only 8-bit binary P5/P6 images are supported")
+    channels = 3 if magic == b"P6" else 1
+    pixels = data[pos + 1:pos + 1 + width * height * channels]
+    if len(pixels) != width * height * channels:
+        sys.exit(f"{path}: truncated pixel data")
+    return width, height, channels, pixels
+
+
+def to_dac(c):
+    return (c * 63 + 127) // 255
+
+
+def index_colors(rgb, first):
+    colors = {}
+    for i in range(0, len(rgb), 3):
+        colors.setdefault(rgb[i:i + 3], len(colors))
+    if len(colors) <= 256 - first:
+        palette = bytearray()
+        for color in colors:
+            palette += bytes(to_dac(c) for c in color)
+        return bytes(colors[rgb[i:i + 3]] + first for i in range(0, len(rgb), 3)), palette
+
+    if first + 216 > 256:
+        sys.exit("too many colors for the color cube at this --palette-first")
+    palette = bytearray()
+    for r in range(6):
+        for g in range(6):
+            for b in range(6):
+                palette += bytes((r * 63 // 5, g * 63 // 5, b * 63 // 5))
+    level = lambda c: (c * 5 + 127) // 255
+    pixels = bytes(first + level(rgb[i]) * 36 + level(rgb[i + 1]) * 6 + level(rgb[i + 2])
+                   for i in range(0, len(rgb), 3))
+    return pixels, palette
+
+
+def encode_rle(src):
+    out, i, n = bytearray(), 0, len(src)
+    literals = bytearray()
+
+    def flush():
+        for k in range(0, len(literals), 128):
+            chunk = literals[k:k + 128]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        literals.clear()
+
+    while i < n:
+        run = 1
+        while i + run < n and run < 130 and src[i + run] == src[i]:
+            run += 1
+        if run >= 3:
+            flush()
+            out += bytes((run + 125, src[i]))
+            i += run
+        else:
+            literals.append(src[i])
+            i += 1
+    flush()
+    return bytes(out)
+
+
+def lz4_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def lz4_sequence(out, literals, match_len, offset):
+    lit = len(literals)
+    token = min(lit, 15) << 4
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        lz4_length(out, lit - 15)
+    out.extend(literals)
+    if match_len:
+        out += struct.pack("<H", offset)
+        if match_len - MIN_MATCH >= 15:
+            lz4_length(out, match_len - MIN_MATCH - 15)
+
+
+def encode_lz4(src):
+    """Greedy LZ4 block encoder with hash chains limited to WINDOW."""
+    out, n = bytearray(), len(src)
+    chains = {}
+    anchor = i = 0
+    while i + MIN_MATCH <= n:
+        key = src[i:i + MIN_MATCH]
+        best_len = best_off = 0
+        for cand in reversed(chains.get(key, ())[-16:]):
+            if i - cand > WINDOW:
+                break
+            length = MIN_MATCH
+            while i + length < n and src[cand + length] == src[i + length]:
+                length += 1
+            if length > best_len:
+                best_len, best_off = length, i - cand
+        if best_len:
+            lz4_sequence(out, src[anchor:i], best_len, best_off)
+            for k in range(i, min(i + best_len, n - MIN_MATCH + 1)):
+                chains.setdefault(src[k:k + MIN_MATCH], []).append(k)
+            i += best_len
+            anchor = i
+        else:
+            chains.setdefault(key, []).append(i)
+            i += 1
+    lz4_sequence(out, src[anchor:], 0, 0)
+    return bytes(out)
+
+
+def decode(codec, data, total):
+    """Reference decoder, used by --check."""
+    if codec == CODEC_RAW:
+        return data[:total]
+    out, i = bytearray(), 0
+    while len(out) < total:
+        c = data[i]
+        i += 1
+        if codec == CODEC_RLE:
+            if c < 128:
+                out += data[i:i + c + 1]
+                i += c + 1
+            else:
+                out += bytes([data[i]]) * (c - 125)
+                i += 1
+            continue
+        lit = c >> 4
+        if lit == 15:
+            while True:
+                lit += data[i]
+                i += 1
+                if data[i - 1] != 255:
+                    break
+        out += data[i:i + lit]
+        i += lit
+        if len(out) >= total:
+            break
+        offset = data[i] | data[i + 1] << 8
+        i += 2
+        length = (c & 15) + MIN_MATCH
+        if c & 15 == 15:
+            while True:
+                length += data[i]
+                i += 1
+                if data[i - 1] != 255:
+                    break
+        for _ in range(length):
+            out.append(out[-offset])
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--codec", choices=("raw", "rle", "lz4"), default="lz4")
+    parser.add_argument("--palette-first", type=int, default=16,
+                        help="first DAC entry the image palette replaces (default 16)")
+    parser.add_argument("--check", action="store_true", help="decode the result and compare")
+    args = parser.parse_args()
+
+    width, height, channels, pnm = read_pnm(args.input)
+    if channels == 3:
+        pixels, palette = index_colors(pnm, args.palette_first)
+    else:
+        pixels, palette = pnm, b""
+
+    codec = {"raw": CODEC_RAW, "rle": CODEC_RLE, "lz4": CODEC_LZ4}[args.codec]
+    data = {CODEC_RAW: bytes, CODEC_RLE: encode_rle, CODEC_LZ4: encode_lz4}[codec](pixels)
+    if args.check and decode(codec, data, len(pixels)) != pixels:
+        sys.exit("round trip mismatch")
+
+    header = b"MTI1" + struct.pack("<HHBBHI", width, height, codec, args.palette_first if palette else 0,
+                                   len(palette) // 3, len(data))
+    with open(args.output, "wb") as f:
+        f.write(header + palette + data)
+    print(f"{args.output}: {width}x{height}, {len(palette) // 3} colors, "
+          f"{len(pixels)} -> {len(data)} bytes ({args.codec})")
+
+
+if __name__ == "__main__":
+    main()
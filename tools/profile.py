@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Symbolize a sampling profile dumped by the kernel's "profile" serial command.
+
+    tools/profile.py serial.log kernel.elf
+    tools/profile.py serial.log kernel.elf --folded out.folded
+    flamegraph.pl out.folded > profile.svg
+
+Prints a flat profile (samples whose EIP falls in each function) and, with
+--folded, writes caller;...;callee stacks in the folded format flame graph
+tools read. The last dump in the log is used.
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import subprocess
+import sys
+
+
+def read_dump(path):
+    with open(path, "rb") as f:
+        lines = f.read().decode("latin-1").splitlines()
+    start = None
+    for i, line in enumerate(lines):
+        if line.startswith("PROFILE samples"):
+            start = i
+    if start is None:
+        sys.exit(f"{path}: no PROFILE dump found")
+
+    header = lines[start].strip()
+    stacks = []
+    for line in lines[start + 1:]:
+        line = line.strip()
+        if line == "PROFILE END":
+            return header, stacks
+        fields = line.split()
+        if fields and fields[0].isdigit():
+            stacks.append((int(fields[0]), [int(pc, 16) for pc in fields[1:]]))
+    sys.exit(f"{path}: PROFILE dump is truncated")
+
+
+def read_symbols(elf, nm):
+    out = subprocess.run([nm, "-n", "--defined-only", elf], check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        m = re.match(r"([0-9a-fA-F]+) [tTwW] (\S+)", line)
+        if m:
+            addrs.append(int(m.group(1), 16))
+            names.append(m.group(2))
+    return addrs, names
+
+
+def symbolize(addrs, names, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    return names[i] if i >= 0 else f"0x{pc:08x}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log")
+    parser.add_argument("elf")
+    parser.add_argument("--nm", default="nm", help="nm to use (e.g. i386-elf-nm)")
+    parser.add_argument("--folded", help="write folded stacks to this file")
+    parser.add_argument("--top", type=int, default=30, help="functions to list (default 30)")
+    args = parser.parse_args()
+
+    header, stacks = read_dump(args.log)
+    addrs, names = read_symbols(args.elf, args.nm)
+
+    flat = collections.Counter()
+    folded = collections.Counter()
+    total = 0
+    for count, pcs in stacks:
+        # callers are return addresses: look up the call instruction before them
+        frames = [symbolize(addrs, names, pcs[0])] + [symbolize(addrs, names, pc - 1) for pc in pcs[1:]]
+        flat[frames[0]] += count
+        folded[";".join(reversed(frames))] += count
+        total += count
+
+    print(header)
+    print(f"{'samples':>8} {'%':>6}  function")
+    for name, count in flat.most_common(args.top):
+        print(f"{count:8d} {100.0 * count / max(total, 1):6.2f}  {name}")
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, count in sorted(folded.items()):
+                f.write(f"{stack} {count}\n")
+
+
+if __name__ == "__main__":
+    main()